@@ -69,6 +69,7 @@ LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/include
 LOCAL_SRC_FILES := acrylic.cpp acrylic_g2d.cpp
 LOCAL_SRC_FILES += acrylic_factory.cpp acrylic_layer.cpp acrylic_formats.cpp
 LOCAL_SRC_FILES += acrylic_performance.cpp acrylic_device.cpp
+LOCAL_SRC_FILES += acrylic_cpu.cpp
 
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE := libacryl
@@ -0,0 +1,902 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#include "acrylic_cpu.h"
+#include "acrylic_cpu_kernels.h"
+
+#include <exynos_format.h> // hardware/smasung_slsi/exynos/include
+#include <hardware/hwcomposer2.h>
+#include <linux/dma-buf.h>
+#include <log/log.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <system/graphics.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#define CPU_COMPOSITOR_SPEC         "cpu_compositor"
+#define CPU_COMPOSITOR_MAX_THREADS  4
+// The number of rows of a unit of work given to a thread
+#define CPU_COMPOSITOR_TILE_ROWS    32
+#define CPU_COMPOSITOR_FENCE_TIMEOUT_MS 3000
+
+/*
+ * The pixels are processed in premultiplied RGBA8888 packed in uint32_t:
+ * R in bits 0-7, G in 8-15, B in 16-23 and A in 24-31. It is the same layout
+ * as HAL_PIXEL_FORMAT_RGBA_8888 in memory on little endian CPUs.
+ */
+enum cpu_pixel_layout {
+    LAYOUT_RGBA8888,
+    LAYOUT_RGBX8888,
+    LAYOUT_BGRA8888,
+    LAYOUT_RGB888,
+    LAYOUT_RGB565,
+    LAYOUT_RGBA1010102,
+    LAYOUT_YCBCR420_SP,  // Y plane and interleaved CbCr plane
+    LAYOUT_YCRCB420_SP,  // Y plane and interleaved CrCb plane
+    LAYOUT_YCBCR420_P,   // Y, Cb and Cr planes
+    LAYOUT_YCRCB420_P,   // Y, Cr and Cb planes
+};
+
+static const struct {
+    uint32_t fmt;
+    cpu_pixel_layout layout;
+    uint8_t chroma_align;   // alignment of the number of bytes in a row of a chroma plane
+    bool writable;          // if it can be the format of the target image
+} __cpu_pixel_formats[] = {
+    {HAL_PIXEL_FORMAT_RGBA_8888,                    LAYOUT_RGBA8888,    1,  true },
+    {HAL_PIXEL_FORMAT_RGBX_8888,                    LAYOUT_RGBX8888,    1,  true },
+    {HAL_PIXEL_FORMAT_BGRA_8888,                    LAYOUT_BGRA8888,    1,  true },
+    {HAL_PIXEL_FORMAT_RGB_888,                      LAYOUT_RGB888,      1,  true },
+    {HAL_PIXEL_FORMAT_RGB_565,                      LAYOUT_RGB565,      1,  true },
+    {HAL_PIXEL_FORMAT_RGBA_1010102,                 LAYOUT_RGBA1010102, 1,  true },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,          LAYOUT_YCBCR420_SP, 1,  false},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M,        LAYOUT_YCBCR420_SP, 1,  false},
+    {HAL_PIXEL_FORMAT_YCrCb_420_SP,                 LAYOUT_YCRCB420_SP, 1,  false},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M,        LAYOUT_YCRCB420_SP, 1,  false},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL,   LAYOUT_YCRCB420_SP, 1,  false},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P,           LAYOUT_YCBCR420_P,  1,  false},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P_M,         LAYOUT_YCBCR420_P,  1,  false},
+    {HAL_PIXEL_FORMAT_YV12,                         LAYOUT_YCRCB420_P,  16, false},
+    {HAL_PIXEL_FORMAT_EXYNOS_YV12_M,                LAYOUT_YCRCB420_P,  1,  false},
+};
+
+static uint32_t __cpu_pixformats[ARRSIZE(__cpu_pixel_formats)] = {
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_BGRA_8888,
+    HAL_PIXEL_FORMAT_RGB_888,
+    HAL_PIXEL_FORMAT_RGB_565,
+    HAL_PIXEL_FORMAT_RGBA_1010102,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M,
+    HAL_PIXEL_FORMAT_YCrCb_420_SP,
+    HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M,
+    HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P_M,
+    HAL_PIXEL_FORMAT_YV12,
+    HAL_PIXEL_FORMAT_EXYNOS_YV12_M,
+};
+
+static int __cpu_dataspaces[] = {
+    HAL_DATASPACE_UNKNOWN,
+    HAL_DATASPACE_SRGB,
+    HAL_DATASPACE_JFIF,
+    HAL_DATASPACE_BT601_525,
+    HAL_DATASPACE_BT601_625,
+    HAL_DATASPACE_BT709,
+    HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_BT601_625 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_BT601_625 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_BT601_525 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_BT601_525 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_BT2020 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_BT2020 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_DCI_P3 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_DCI_P3 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_FILM | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_FILM | HAL_DATASPACE_RANGE_LIMITED,
+};
+
+static const stHW2DCapability __cpu_capability = {
+    .max_upsampling_num = {64, 64},
+    .max_downsampling_factor = {16, 16},
+    .max_upsizing_num = {64, 64},
+    .max_downsizing_factor = {16, 16},
+    .min_src_dimension = {1, 1},
+    .max_src_dimension = {8192, 8192},
+    .min_dst_dimension = {1, 1},
+    .max_dst_dimension = {8192, 8192},
+    .min_pix_align = {1, 1},
+    .rescaling_count = 0,
+    .compositing_mode = HW2DCapability::BLEND_NONE | HW2DCapability::BLEND_SRC_COPY |
+                        HW2DCapability::BLEND_SRC_OVER,
+    .transform_type = HW2DCapability::TRANSFORM_ALL,
+    .auxiliary_feature = HW2DCapability::FEATURE_PLANE_ALPHA | HW2DCapability::FEATURE_SOLIDCOLOR,
+    .num_formats = ARRSIZE(__cpu_pixformats),
+    .num_dataspaces = ARRSIZE(__cpu_dataspaces),
+    .max_layers = 16,
+    .pixformats = __cpu_pixformats,
+    .dataspaces = __cpu_dataspaces,
+    .base_align = 1,
+};
+
+static const HW2DCapability __cpu_hw2d_capability(__cpu_capability);
+
+static int find_cpu_pixel_format(uint32_t fmt)
+{
+    for (size_t i = 0; i < ARRSIZE(__cpu_pixel_formats); i++) {
+        if (__cpu_pixel_formats[i].fmt == fmt)
+            return static_cast<int>(i);
+    }
+
+    return -1;
+}
+
+/*
+ * The standard and the range of YCbCr are chosen from the dataspace in the
+ * same way as G2D so that the results of both can be compared.
+ */
+static void get_csc_coefficients(uint32_t fmt, int dataspace, CpuCscCoefficients &csc)
+{
+    double kr, kb;
+
+    switch ((dataspace & HAL_DATASPACE_STANDARD_MASK) >> HAL_DATASPACE_STANDARD_SHIFT) {
+        case HAL_DATASPACE_STANDARD_BT601_625 >> HAL_DATASPACE_STANDARD_SHIFT:
+        case HAL_DATASPACE_STANDARD_BT601_625_UNADJUSTED >> HAL_DATASPACE_STANDARD_SHIFT:
+        case HAL_DATASPACE_STANDARD_BT601_525 >> HAL_DATASPACE_STANDARD_SHIFT:
+        case HAL_DATASPACE_STANDARD_BT601_525_UNADJUSTED >> HAL_DATASPACE_STANDARD_SHIFT:
+            kr = 0.299;
+            kb = 0.114;
+            break;
+        case HAL_DATASPACE_STANDARD_BT2020 >> HAL_DATASPACE_STANDARD_SHIFT:
+        case HAL_DATASPACE_STANDARD_BT2020_CONSTANT_LUMINANCE >> HAL_DATASPACE_STANDARD_SHIFT:
+            kr = 0.2627;
+            kb = 0.0593;
+            break;
+        case HAL_DATASPACE_STANDARD_DCI_P3 >> HAL_DATASPACE_STANDARD_SHIFT:
+            kr = 0.228975;
+            kb = 0.079287;
+            break;
+        default:
+            kr = 0.2126;
+            kb = 0.0722;
+            break;
+    }
+
+    bool full = ((dataspace & HAL_DATASPACE_RANGE_FULL) != 0) ||
+                (fmt == HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL);
+
+    compute_csc_coefficients(kr, kb, full, csc);
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+    uint16_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+/*
+ * CpuImage - the image of AcrylicCanvas mapped to the address space of CPU
+ *
+ * The planes are always in the order of Y, Cb and Cr regardless of the order
+ * in the memory. Interleaved chroma is in the second plane.
+ */
+class CpuImage {
+public:
+    CpuImage() { }
+    ~CpuImage() { unmap(); }
+
+    bool map(AcrylicCanvas &canvas, bool writable);
+    void unmap();
+
+    void loadRow(const CpuCscCoefficients &csc, int32_t x, int32_t y, int32_t count, uint32_t *out);
+    void storeRow(int32_t y, const uint32_t *in);
+
+    cpu_pixel_layout getLayout() { return mLayout; }
+    int32_t getWidth() { return mWidth; }
+    int32_t getHeight() { return mHeight; }
+private:
+    DISALLOW_COPY_AND_ASSIGN(CpuImage);
+
+    cpu_pixel_layout mLayout = LAYOUT_RGBA8888;
+    int32_t mWidth = 0;
+    int32_t mHeight = 0;
+    uint8_t *mPlane[3] = {nullptr, nullptr, nullptr};
+    size_t mStride[3] = {0, 0, 0};
+
+    unsigned int mMappedCount = 0;
+    void *mMappedAddr[MAX_HW2D_PLANES];
+    size_t mMappedLength[MAX_HW2D_PLANES];
+    int mMappedFd[MAX_HW2D_PLANES];
+    uint64_t mSyncFlags = 0;
+};
+
+static size_t bytes_per_pixel(cpu_pixel_layout layout)
+{
+    switch (layout) {
+        case LAYOUT_RGB888:
+            return 3;
+        case LAYOUT_RGB565:
+            return 2;
+        case LAYOUT_YCBCR420_SP:
+        case LAYOUT_YCRCB420_SP:
+        case LAYOUT_YCBCR420_P:
+        case LAYOUT_YCRCB420_P:
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+bool CpuImage::map(AcrylicCanvas &canvas, bool writable)
+{
+    unmap();
+
+    int idx = find_cpu_pixel_format(canvas.getFormat());
+    if (idx < 0) {
+        ALOGE("Format %#x is not supported by the CPU compositor", canvas.getFormat());
+        return false;
+    }
+
+    if (canvas.isProtected()) {
+        ALOGE("Protected buffers are not accessible by the CPU compositor");
+        return false;
+    }
+
+    hw2d_coord_t xy = canvas.getImageDimension();
+    cpu_pixel_layout layout = __cpu_pixel_formats[idx].layout;
+    bool ycbcr = layout >= LAYOUT_YCBCR420_SP;
+    unsigned int num_planes = ycbcr ? ((layout >= LAYOUT_YCBCR420_P) ? 3 : 2) : 1;
+    size_t plane_len[3];
+
+    mLayout = layout;
+    mWidth = xy.hori;
+    mHeight = xy.vert;
+
+    mStride[0] = mWidth * bytes_per_pixel(layout);
+    plane_len[0] = mStride[0] * mHeight;
+
+    if (ycbcr) {
+        size_t chroma_height = (mHeight + 1) / 2;
+        size_t align = __cpu_pixel_formats[idx].chroma_align;
+
+        if (num_planes == 2) {
+            mStride[1] = (mWidth + 1) & ~1;
+        } else {
+            mStride[1] = (((mWidth + 1) / 2) + align - 1) & ~(align - 1);
+            mStride[2] = mStride[1];
+            plane_len[2] = mStride[2] * chroma_height;
+        }
+        plane_len[1] = mStride[1] * chroma_height;
+    }
+
+    unsigned int num_buffers = canvas.getBufferCount();
+    if ((num_buffers != 1) && (num_buffers != num_planes)) {
+        ALOGE("%u buffers are given for format %#x with %u planes",
+              num_buffers, canvas.getFormat(), num_planes);
+        return false;
+    }
+
+    uint8_t *base[MAX_HW2D_PLANES];
+    size_t avail[MAX_HW2D_PLANES];
+
+    mSyncFlags = DMA_BUF_SYNC_READ | (writable ? DMA_BUF_SYNC_WRITE : 0);
+
+    for (unsigned int i = 0; i < num_buffers; i++) {
+        size_t len = canvas.getBufferLength(i);
+        size_t offset = canvas.getOffset(i);
+
+        if (canvas.getBufferType() == AcrylicCanvas::MT_USERPTR) {
+            base[i] = static_cast<uint8_t *>(canvas.getUserptr(i));
+        } else if (canvas.getBufferType() == AcrylicCanvas::MT_DMABUF) {
+            int fd = canvas.getDmabuf(i);
+            void *addr = mmap(NULL, len, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                ALOGERR("Failed to map buffer[%u] (fd %d, len %zu)", i, fd, len);
+                return false;
+            }
+
+            mMappedAddr[mMappedCount] = addr;
+            mMappedLength[mMappedCount] = len;
+            mMappedFd[mMappedCount] = fd;
+            mMappedCount++;
+
+            struct dma_buf_sync sync = {.flags = DMA_BUF_SYNC_START | mSyncFlags};
+            if (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+                ALOGERR("Failed to start CPU access to buffer[%u] (fd %d)", i, fd);
+
+            base[i] = static_cast<uint8_t *>(addr) + offset;
+        } else {
+            ALOGE("Buffer type %d is not supported by the CPU compositor", canvas.getBufferType());
+            return false;
+        }
+
+        avail[i] = len - offset;
+    }
+
+    size_t offset = 0;
+    for (unsigned int i = 0; i < num_planes; i++) {
+        unsigned int buf = (num_buffers == 1) ? 0 : i;
+
+        if (buf > 0)
+            offset = 0;
+
+        if (avail[buf] < offset + plane_len[i]) {
+            ALOGE("Too small buffer[%u] of %zu bytes for plane %u of format %#x in %dx%d",
+                  buf, avail[buf], i, canvas.getFormat(), mWidth, mHeight);
+            return false;
+        }
+
+        mPlane[i] = base[buf] + offset;
+        offset += plane_len[i];
+    }
+
+    if (layout == LAYOUT_YCRCB420_P)
+        std::swap(mPlane[1], mPlane[2]);
+
+    return true;
+}
+
+void CpuImage::unmap()
+{
+    for (unsigned int i = 0; i < mMappedCount; i++) {
+        struct dma_buf_sync sync = {.flags = DMA_BUF_SYNC_END | mSyncFlags};
+        if (ioctl(mMappedFd[i], DMA_BUF_IOCTL_SYNC, &sync) < 0)
+            ALOGERR("Failed to end CPU access to buffer (fd %d)", mMappedFd[i]);
+
+        munmap(mMappedAddr[i], mMappedLength[i]);
+    }
+
+    mMappedCount = 0;
+    mPlane[0] = mPlane[1] = mPlane[2] = nullptr;
+}
+
+void CpuImage::loadRow(const CpuCscCoefficients &csc, int32_t x, int32_t y, int32_t count, uint32_t *out)
+{
+    const uint8_t *row = mPlane[0] + mStride[0] * y + bytes_per_pixel(mLayout) * x;
+
+    switch (mLayout) {
+        case LAYOUT_RGBA8888:
+            memcpy(out, row, count * sizeof(*out));
+            break;
+        case LAYOUT_RGBX8888:
+            for (int32_t i = 0; i < count; i++)
+                out[i] = read_u32(row + i * 4) | 0xFF000000;
+            break;
+        case LAYOUT_BGRA8888:
+            for (int32_t i = 0; i < count; i++) {
+                uint32_t p = read_u32(row + i * 4);
+                out[i] = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+            }
+            break;
+        case LAYOUT_RGB888:
+            for (int32_t i = 0; i < count; i++, row += 3)
+                out[i] = row[0] | (row[1] << 8) | (row[2] << 16) | 0xFF000000;
+            break;
+        case LAYOUT_RGB565:
+            for (int32_t i = 0; i < count; i++) {
+                uint32_t p = read_u16(row + i * 2);
+                uint32_t r = p >> 11, g = (p >> 5) & 0x3F, b = p & 0x1F;
+                out[i] = ((r << 3) | (r >> 2)) | (((g << 2) | (g >> 4)) << 8) |
+                         (((b << 3) | (b >> 2)) << 16) | 0xFF000000;
+            }
+            break;
+        case LAYOUT_RGBA1010102:
+            for (int32_t i = 0; i < count; i++) {
+                uint32_t p = read_u32(row + i * 4);
+                out[i] = ((p >> 2) & 0xFF) | (((p >> 12) & 0xFF) << 8) |
+                         (((p >> 22) & 0xFF) << 16) | ((p >> 30) * 0x55 << 24);
+            }
+            break;
+        case LAYOUT_YCBCR420_SP:
+        case LAYOUT_YCRCB420_SP: {
+            const uint8_t *chroma = mPlane[1] + mStride[1] * (y / 2);
+            unsigned int cb = (mLayout == LAYOUT_YCBCR420_SP) ? 0 : 1;
+
+            for (int32_t i = 0; i < count; i++) {
+                const uint8_t *c = chroma + ((x + i) & ~1);
+                out[i] = ycbcr_to_rgba(csc, row[i], c[cb], c[cb ^ 1]);
+            }
+            break;
+        }
+        case LAYOUT_YCBCR420_P:
+        case LAYOUT_YCRCB420_P: {
+            const uint8_t *cb = mPlane[1] + mStride[1] * (y / 2);
+            const uint8_t *cr = mPlane[2] + mStride[2] * (y / 2);
+
+            for (int32_t i = 0; i < count; i++)
+                out[i] = ycbcr_to_rgba(csc, row[i], cb[(x + i) / 2], cr[(x + i) / 2]);
+            break;
+        }
+    }
+}
+
+void CpuImage::storeRow(int32_t y, const uint32_t *in)
+{
+    uint8_t *row = mPlane[0] + mStride[0] * y;
+
+    switch (mLayout) {
+        case LAYOUT_RGBA8888:
+            memcpy(row, in, mWidth * sizeof(*in));
+            break;
+        case LAYOUT_RGBX8888:
+            for (int32_t i = 0; i < mWidth; i++) {
+                uint32_t p = in[i] | 0xFF000000;
+                memcpy(row + i * 4, &p, sizeof(p));
+            }
+            break;
+        case LAYOUT_BGRA8888:
+            for (int32_t i = 0; i < mWidth; i++) {
+                uint32_t p = (in[i] & 0xFF00FF00) | ((in[i] >> 16) & 0xFF) | ((in[i] & 0xFF) << 16);
+                memcpy(row + i * 4, &p, sizeof(p));
+            }
+            break;
+        case LAYOUT_RGB888:
+            for (int32_t i = 0; i < mWidth; i++, row += 3) {
+                row[0] = in[i] & 0xFF;
+                row[1] = (in[i] >> 8) & 0xFF;
+                row[2] = (in[i] >> 16) & 0xFF;
+            }
+            break;
+        case LAYOUT_RGB565:
+            for (int32_t i = 0; i < mWidth; i++) {
+                uint16_t p = static_cast<uint16_t>(((in[i] & 0xF8) << 8) | ((in[i] >> 5) & 0x07E0) |
+                                                   ((in[i] >> 19) & 0x1F));
+                memcpy(row + i * 2, &p, sizeof(p));
+            }
+            break;
+        case LAYOUT_RGBA1010102:
+            for (int32_t i = 0; i < mWidth; i++) {
+                uint32_t r = in[i] & 0xFF, g = (in[i] >> 8) & 0xFF, b = (in[i] >> 16) & 0xFF;
+                uint32_t p = ((r << 2) | (r >> 6)) | (((g << 2) | (g >> 6)) << 10) |
+                             (((b << 2) | (b >> 6)) << 20) | ((in[i] >> 30) << 30);
+                memcpy(row + i * 4, &p, sizeof(p));
+            }
+            break;
+        default:
+            LOGASSERT(false, "Writing YCbCr images is not supported");
+            break;
+    }
+}
+
+// The source image of a layer and how it is mapped to the target image
+struct CpuSource {
+    AcrylicLayer *layer = nullptr;
+    CpuImage image;
+    CpuCscCoefficients csc;
+    uint32_t *staging = nullptr;    // premultiplied RGBA8888 of the crop area
+    hw2d_rect_t crop;
+    hw2d_rect_t window;
+    uint32_t color = 0;             // premultiplied solid color
+    uint32_t blending;
+    uint32_t alpha;
+    bool solid = false;
+    bool filter = false;
+    CpuSourceMapping map;
+};
+
+static void setup_source_mapping(CpuSource &src)
+{
+    get_source_mapping(src.layer->getTransform(), src.crop.size, src.window.size, src.map);
+
+    src.filter = src.map.scaled && !(src.layer->getCompositAttr() & AcrylicLayer::ATTR_NORESAMPLING);
+}
+
+static inline bool is_blending(uint32_t mode, uint32_t hwc, uint32_t hwc2)
+{
+    return (mode == hwc) || (mode == hwc2);
+}
+
+// Make the pixels in premultiplied form according to the blending mode
+static void apply_blending(uint32_t blending, uint32_t *pixels, int32_t count)
+{
+    if (is_blending(blending, HWC_BLENDING_NONE, HWC2_BLEND_MODE_NONE)) {
+        for (int32_t i = 0; i < count; i++)
+            pixels[i] |= 0xFF000000;
+    } else if (is_blending(blending, HWC_BLENDING_COVERAGE, HWC2_BLEND_MODE_COVERAGE)) {
+        for (int32_t i = 0; i < count; i++)
+            pixels[i] = premultiply_pixel(pixels[i]);
+    }
+}
+
+// Fetch @count pixels from the row @v of the window of @src
+static void sample_row(CpuSource &src, int32_t v, int32_t count, uint32_t *out)
+{
+    int32_t cw = src.crop.size.hori;
+    int32_t ch = src.crop.size.vert;
+    int64_t sx = src.map.sx + src.map.sx_dv * v;
+    int64_t sy = src.map.sy + src.map.sy_dv * v;
+
+    if (!src.filter) {
+        if ((src.map.sx_du == 65536) && (src.map.sy_du == 0)) {
+            int32_t y = std::min(std::max(static_cast<int32_t>(sy >> 16), 0), ch - 1);
+            int32_t x = std::min(std::max(static_cast<int32_t>(sx >> 16), 0), cw - count);
+            memcpy(out, src.staging + y * cw + x, count * sizeof(*out));
+            return;
+        }
+
+        for (int32_t i = 0; i < count; i++, sx += src.map.sx_du, sy += src.map.sy_du) {
+            int32_t x = std::min(std::max(static_cast<int32_t>(sx >> 16), 0), cw - 1);
+            int32_t y = std::min(std::max(static_cast<int32_t>(sy >> 16), 0), ch - 1);
+            out[i] = src.staging[y * cw + x];
+        }
+        return;
+    }
+
+    // bilinear interpolation between the centers of the neighboring pixels
+    sx -= 32768;
+    sy -= 32768;
+
+    for (int32_t i = 0; i < count; i++, sx += src.map.sx_du, sy += src.map.sy_du) {
+        int32_t x0 = static_cast<int32_t>(sx >> 16);
+        int32_t y0 = static_cast<int32_t>(sy >> 16);
+        uint32_t fx = static_cast<uint32_t>((sx >> 8) & 0xFF);
+        uint32_t fy = static_cast<uint32_t>((sy >> 8) & 0xFF);
+        int32_t x1 = std::min(std::max(x0 + 1, 0), cw - 1);
+        int32_t y1 = std::min(std::max(y0 + 1, 0), ch - 1);
+
+        x0 = std::min(std::max(x0, 0), cw - 1);
+        y0 = std::min(std::max(y0, 0), ch - 1);
+
+        const uint32_t *r0 = src.staging + y0 * cw;
+        const uint32_t *r1 = src.staging + y1 * cw;
+
+        out[i] = lerp_pixel(lerp_pixel(r0[x0], r0[x1], fx), lerp_pixel(r1[x0], r1[x1], fx), fy);
+    }
+}
+
+static bool wait_fence(int fence)
+{
+    if (fence < 0)
+        return true;
+
+    struct pollfd fds = {.fd = fence, .events = POLLIN, .revents = 0};
+    int ret;
+
+    do {
+        ret = poll(&fds, 1, CPU_COMPOSITOR_FENCE_TIMEOUT_MS);
+    } while ((ret < 0) && ((errno == EINTR) || (errno == EAGAIN)));
+
+    if (ret == 0) {
+        ALOGE("Acquire fence %d is not signaled in %d msec.", fence, CPU_COMPOSITOR_FENCE_TIMEOUT_MS);
+        return false;
+    } else if (ret < 0) {
+        ALOGERR("Failed to wait for acquire fence %d", fence);
+        return false;
+    }
+
+    return true;
+}
+
+AcrylicCompositorCPU::AcrylicCompositorCPU(const HW2DCapability &capability)
+    : Acrylic(capability), mLaptimeUSec(0)
+{
+    unsigned int cpus = std::thread::hardware_concurrency();
+
+    mThreadCount = std::min(std::max(cpus, 1U), static_cast<unsigned int>(CPU_COMPOSITOR_MAX_THREADS));
+
+    for (unsigned int i = 1; i < mThreadCount; i++)
+        mWorkers.emplace_back(&AcrylicCompositorCPU::runWorker, this);
+
+    ALOGD_TEST("Created a new Acrylic for CPU on %p with %u threads", this, mThreadCount);
+}
+
+AcrylicCompositorCPU::~AcrylicCompositorCPU()
+{
+    {
+        std::lock_guard<std::mutex> lock(mPoolLock);
+        mExiting = true;
+    }
+    mWorkCond.notify_all();
+
+    for (auto &worker: mWorkers)
+        worker.join();
+
+    ALOGD_TEST("Deleting Acrylic for CPU on %p", this);
+}
+
+void AcrylicCompositorCPU::processTiles(unsigned int count, const std::function<void(unsigned int)> &work)
+{
+    for (unsigned int i = mNextTile++; i < count; i = mNextTile++)
+        work(i);
+}
+
+void AcrylicCompositorCPU::runWorker()
+{
+    unsigned int generation = 0;
+    std::unique_lock<std::mutex> lock(mPoolLock);
+
+    while (true) {
+        mWorkCond.wait(lock, [this, generation] { return mExiting || (mGeneration != generation); });
+        if (mExiting)
+            return;
+
+        generation = mGeneration;
+
+        const std::function<void(unsigned int)> *work = mWork;
+        unsigned int count = mWorkCount;
+
+        lock.unlock();
+        processTiles(count, *work);
+        lock.lock();
+
+        if (--mBusyWorkers == 0)
+            mDoneCond.notify_one();
+    }
+}
+
+void AcrylicCompositorCPU::runTiles(unsigned int count, const std::function<void(unsigned int)> &work)
+{
+    mNextTile = 0;
+
+    // Waking the workers up costs more than a single tile
+    if (mWorkers.empty() || (count < 2)) {
+        processTiles(count, work);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mPoolLock);
+        mWork = &work;
+        mWorkCount = count;
+        mBusyWorkers = static_cast<unsigned int>(mWorkers.size());
+        mGeneration++;
+    }
+    mWorkCond.notify_all();
+
+    processTiles(count, work);
+
+    // @work should not be referenced by the workers after return
+    std::unique_lock<std::mutex> lock(mPoolLock);
+    mDoneCond.wait(lock, [this] { return mBusyWorkers == 0; });
+    mWork = nullptr;
+}
+
+bool AcrylicCompositorCPU::executeCPU()
+{
+    ATRACE_CALL();
+    if (!validateAllLayers())
+        return false;
+
+    AcrylicCanvas &canvas = getCanvas();
+
+    int idx = find_cpu_pixel_format(canvas.getFormat());
+    if ((idx < 0) || !__cpu_pixel_formats[idx].writable) {
+        ALOGE("Target format %#x is not supported by the CPU compositor", canvas.getFormat());
+        return false;
+    }
+
+    sortLayers();
+
+    auto begin = std::chrono::steady_clock::now();
+
+    if (!wait_fence(canvas.getFence()))
+        return false;
+
+    for (unsigned int i = 0; i < layerCount(); i++) {
+        if (!wait_fence(getLayer(i)->getFence()))
+            return false;
+    }
+
+    CpuImage target;
+    if (!target.map(canvas, true))
+        return false;
+
+    unsigned int count = layerCount();
+    std::unique_ptr<CpuSource[]> sources(new CpuSource[count]);
+    hw2d_coord_t xy = canvas.getImageDimension();
+
+    mStaging.resize(count);
+
+    for (unsigned int i = 0; i < count; i++) {
+        CpuSource &src = sources[i];
+        AcrylicLayer *layer = getLayer(i);
+
+        src.layer = layer;
+        src.crop = layer->getImageRect();
+        src.window = layer->getTargetRect();
+        if (area_is_zero(src.window)) {
+            src.window.pos = {0, 0};
+            src.window.size = xy;
+        }
+        src.blending = layer->getCompositingMode();
+        src.alpha = layer->getPlaneAlpha();
+
+        if (layer->isSolidColor()) {
+            uint32_t color = layer->getSolidColor();
+
+            src.solid = true;
+            src.color = ((color >> 16) & 0xFF) | (color & 0xFF00) | ((color & 0xFF) << 16) |
+                        (color & 0xFF000000);
+            apply_blending(src.blending, &src.color, 1);
+            continue;
+        }
+
+        if (!src.image.map(*layer, false))
+            return false;
+
+        get_csc_coefficients(layer->getFormat(), layer->getDataspace(), src.csc);
+        setup_source_mapping(src);
+
+        mStaging[i].resize(src.crop.size.hori * src.crop.size.vert);
+        src.staging = mStaging[i].data();
+    }
+
+    // Convert the crop area of the source images into premultiplied RGBA8888
+    std::vector<unsigned int> first_tile(count + 1, 0);
+
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int tiles = sources[i].solid ? 0 :
+                (sources[i].crop.size.vert + CPU_COMPOSITOR_TILE_ROWS - 1) / CPU_COMPOSITOR_TILE_ROWS;
+        first_tile[i + 1] = first_tile[i] + tiles;
+    }
+
+    runTiles(first_tile[count], [&sources, &first_tile, count] (unsigned int tile) {
+        unsigned int i = static_cast<unsigned int>(
+                std::upper_bound(first_tile.begin(), first_tile.begin() + count + 1, tile) -
+                first_tile.begin()) - 1;
+        CpuSource &src = sources[i];
+        int32_t width = src.crop.size.hori;
+        int32_t row = (tile - first_tile[i]) * CPU_COMPOSITOR_TILE_ROWS;
+        int32_t end = std::min(row + CPU_COMPOSITOR_TILE_ROWS, static_cast<int32_t>(src.crop.size.vert));
+
+        for (; row < end; row++) {
+            uint32_t *out = src.staging + row * width;
+
+            src.image.loadRow(src.csc, src.crop.pos.hori, src.crop.pos.vert + row, width, out);
+            apply_blending(src.blending, out, width);
+        }
+    });
+
+    // Composit the source images onto the target image by bands of rows
+    bool has_background = hasBackgroundColor();
+    uint32_t background = 0;
+
+    if (has_background) {
+        uint16_t r, g, b, a;
+
+        getBackgroundColor(&r, &g, &b, &a);
+        background = premultiply_pixel((r >> 8) | (g & 0xFF00) | ((b >> 8) << 16) | ((a >> 8) << 24));
+    }
+
+    unsigned int tiles = (xy.vert + CPU_COMPOSITOR_TILE_ROWS - 1) / CPU_COMPOSITOR_TILE_ROWS;
+
+    runTiles(tiles, [&sources, &target, count, has_background, background] (unsigned int tile) {
+        int32_t width = target.getWidth();
+        int32_t row = tile * CPU_COMPOSITOR_TILE_ROWS;
+        int32_t end = std::min(row + CPU_COMPOSITOR_TILE_ROWS, target.getHeight());
+        std::vector<uint32_t> dst(width);
+        std::vector<uint32_t> span(width);
+        CpuCscCoefficients csc = {};
+
+        for (; row < end; row++) {
+            // Without the background color, the sources are blended onto the target image
+            if (has_background)
+                std::fill(dst.begin(), dst.end(), background);
+            else
+                target.loadRow(csc, 0, row, width, dst.data());
+
+            for (unsigned int i = 0; i < count; i++) {
+                CpuSource &src = sources[i];
+                int32_t v = row - src.window.pos.vert;
+
+                if ((v < 0) || (v >= src.window.size.vert))
+                    continue;
+
+                int32_t len = src.window.size.hori;
+                uint32_t *out = dst.data() + src.window.pos.hori;
+
+                if (src.solid) {
+                    std::fill(span.begin(), span.begin() + len, src.color);
+                } else if (is_blending(src.blending, HWC_BLENDING_NONE, HWC2_BLEND_MODE_NONE) &&
+                           (src.alpha == 255)) {
+                    sample_row(src, v, len, out);
+                    continue;
+                } else {
+                    sample_row(src, v, len, span.data());
+                }
+
+                blend_row(out, span.data(), len, src.alpha);
+            }
+
+            target.storeRow(row, dst.data());
+        }
+    });
+
+    auto laptime = std::chrono::steady_clock::now() - begin;
+    mLaptimeUSec = static_cast<unsigned int>(
+            std::chrono::duration_cast<std::chrono::microseconds>(laptime).count());
+
+    canvas.clearSettingModified();
+    canvas.setFence(-1);
+
+    for (unsigned int i = 0; i < layerCount(); i++) {
+        getLayer(i)->clearSettingModified();
+        getLayer(i)->setFence(-1);
+    }
+
+    return true;
+}
+
+bool AcrylicCompositorCPU::execute(int fence[], unsigned int num_fences)
+{
+    if (!executeCPU()) {
+        // Clearing all acquire fences because their buffers are expired.
+        // The clients should configure everything again to start new execution
+        for (unsigned int i = 0; i < layerCount(); i++)
+            getLayer(i)->setFence(-1);
+        getCanvas().setFence(-1);
+
+        return false;
+    }
+
+    // The images are already processed. No release fence is required.
+    for (unsigned int i = 0; i < num_fences; i++)
+        fence[i] = -1;
+
+    return true;
+}
+
+bool AcrylicCompositorCPU::execute(int *handle)
+{
+    if (!executeCPU()) {
+        // Clearing all acquire fences because their buffers are expired.
+        // The clients should configure everything again to start new execution
+        for (unsigned int i = 0; i < layerCount(); i++)
+            getLayer(i)->setFence(-1);
+        getCanvas().setFence(-1);
+
+        return false;
+    }
+
+    if (handle != NULL)
+        *handle = 1; /* dummy handle */
+
+    return true;
+}
+
+bool AcrylicCompositorCPU::waitExecution(int __unused handle)
+{
+    return true;
+}
+
+Acrylic *createAcrylicCompositorCPU(const char *spec)
+{
+    if (strcmp(spec, CPU_COMPOSITOR_SPEC) != 0)
+        return nullptr;
+
+    return new AcrylicCompositorCPU(__cpu_hw2d_capability);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_ACRYLIC_CPU_H__
+#define __HARDWARE_EXYNOS_ACRYLIC_CPU_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <hardware/exynos/acryl.h>
+
+#include "acrylic_internal.h"
+
+/*
+ * AcrylicCompositorCPU - The implementation of Acrylic that composits with CPU
+ *
+ * It follows the same contract of AcrylicLayer and AcrylicCanvas as the H/W
+ * compositors: color formats, blending modes, plane alpha, transforms,
+ * scaling and YCbCr to RGB conversion. The target image is divided into
+ * bands of rows that are processed in parallel by a pool of worker threads
+ * created with the compositor.
+ * It is the fallback when HW 2D is not available and the reference to study
+ * the results of HW 2D on hosts without HW 2D.
+ * Compressed images, protected buffers and HDR processing are not supported.
+ * RGB images are composited without gamut mapping.
+ * The processing completes before execute() returns. Hence, the release
+ * fences given by execute() are always -1.
+ */
+class AcrylicCompositorCPU: public Acrylic {
+public:
+    AcrylicCompositorCPU(const HW2DCapability &capability);
+    virtual ~AcrylicCompositorCPU();
+    virtual bool execute(int fence[], unsigned int num_fences);
+    virtual bool execute(int *handle = NULL);
+    virtual bool waitExecution(int handle);
+    virtual unsigned int getLaptimeUSec() { return mLaptimeUSec; }
+private:
+    bool executeCPU();
+    /*
+     * Call @work with every index from 0 to @count - 1 by the workers and
+     * the calling thread. It returns after @work is done with all indices.
+     */
+    void runTiles(unsigned int count, const std::function<void(unsigned int)> &work);
+    void runWorker();
+    void processTiles(unsigned int count, const std::function<void(unsigned int)> &work);
+
+    unsigned int mThreadCount;
+    /*
+     * mThreadCount - 1 threads that live as long as this compositor.
+     * A new batch of runTiles() is posted by increasing mGeneration.
+     */
+    std::vector<std::thread> mWorkers;
+    std::mutex mPoolLock;
+    std::condition_variable mWorkCond;
+    std::condition_variable mDoneCond;
+    const std::function<void(unsigned int)> *mWork = nullptr;
+    unsigned int mWorkCount = 0;
+    unsigned int mGeneration = 0;
+    unsigned int mBusyWorkers = 0;
+    bool mExiting = false;
+    std::atomic<unsigned int> mNextTile{0};
+    unsigned int mLaptimeUSec;
+    /* the source images converted to premultiplied RGBA8888 */
+    std::vector<std::vector<uint32_t>> mStaging;
+};
+
+Acrylic *createAcrylicCompositorCPU(const char *spec);
+
+#endif //__HARDWARE_EXYNOS_ACRYLIC_CPU_H__
@@ -0,0 +1,244 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_ACRYLIC_CPU_KERNELS_H__
+#define __HARDWARE_EXYNOS_ACRYLIC_CPU_KERNELS_H__
+
+#include <system/graphics.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <hardware/exynos/acryl.h>
+
+/*
+ * The pixel kernels of AcrylicCompositorCPU. They have no dependency on the
+ * buffers and the layers so that they are tested on hosts as well.
+ * Pixels are RGBA8888 with R in the least significant byte.
+ */
+
+/*
+ * Fixed point coefficients of the conversion from YCbCr to RGB with 12
+ * fraction bits.
+ */
+struct CpuCscCoefficients {
+    int32_t y;
+    int32_t y_offset;
+    int32_t cr_r;
+    int32_t cb_g;
+    int32_t cr_g;
+    int32_t cb_b;
+};
+
+#define CSC_FRACTION_BITS 12
+
+// @kr and @kb are the luma weights of red and blue of the standard
+static inline void compute_csc_coefficients(double kr, double kb, bool full, CpuCscCoefficients &csc)
+{
+    double yscale = full ? 1.0 : 255.0 / 219.0;
+    double cscale = full ? 1.0 : 255.0 / 224.0;
+    double kg = 1.0 - kr - kb;
+    double one = 1 << CSC_FRACTION_BITS;
+
+    csc.y = static_cast<int32_t>(lround(yscale * one));
+    csc.y_offset = full ? 0 : 16;
+    csc.cr_r = static_cast<int32_t>(lround(2.0 * (1.0 - kr) * cscale * one));
+    csc.cb_g = static_cast<int32_t>(lround(2.0 * kb * (1.0 - kb) / kg * cscale * one));
+    csc.cr_g = static_cast<int32_t>(lround(2.0 * kr * (1.0 - kr) / kg * cscale * one));
+    csc.cb_b = static_cast<int32_t>(lround(2.0 * (1.0 - kb) * cscale * one));
+}
+
+static inline uint32_t clamp_u8(int32_t val)
+{
+    return static_cast<uint32_t>(std::min(std::max(val, 0), 255));
+}
+
+static inline uint32_t ycbcr_to_rgba(const CpuCscCoefficients &csc, int32_t y, int32_t cb, int32_t cr)
+{
+    int32_t luma = (y - csc.y_offset) * csc.y + (1 << (CSC_FRACTION_BITS - 1));
+
+    cb -= 128;
+    cr -= 128;
+
+    uint32_t r = clamp_u8((luma + csc.cr_r * cr) >> CSC_FRACTION_BITS);
+    uint32_t g = clamp_u8((luma - csc.cb_g * cb - csc.cr_g * cr) >> CSC_FRACTION_BITS);
+    uint32_t b = clamp_u8((luma + csc.cb_b * cb) >> CSC_FRACTION_BITS);
+
+    return r | (g << 8) | (b << 16) | 0xFF000000;
+}
+
+/*
+ * The kernels below process two 8-bit channels at once in each half of a
+ * 32-bit word. NEON versions are used for blending where it is available.
+ */
+
+// (@p * @a / 255) for each channel with rounding
+static inline uint32_t mul_pixel(uint32_t p, uint32_t a)
+{
+    uint32_t rb = (p & 0x00FF00FF) * a + 0x00800080;
+    uint32_t ag = ((p >> 8) & 0x00FF00FF) * a + 0x00800080;
+
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+
+    return rb | ag;
+}
+
+// (@p1 + @p2) for each channel saturated to 255
+static inline uint32_t add_pixel(uint32_t p1, uint32_t p2)
+{
+    uint32_t rb = (p1 & 0x00FF00FF) + (p2 & 0x00FF00FF);
+    uint32_t ag = ((p1 >> 8) & 0x00FF00FF) + ((p2 >> 8) & 0x00FF00FF);
+
+    rb |= 0x01000100 - ((rb >> 8) & 0x00010001);
+    ag |= 0x01000100 - ((ag >> 8) & 0x00010001);
+
+    return (rb & 0x00FF00FF) | ((ag & 0x00FF00FF) << 8);
+}
+
+// (@p1 * (256 - @f) + @p2 * @f) / 256 for each channel where @f is 0 ~ 256
+static inline uint32_t lerp_pixel(uint32_t p1, uint32_t p2, uint32_t f)
+{
+    uint32_t rb = (p1 & 0x00FF00FF) * (256 - f) + (p2 & 0x00FF00FF) * f + 0x00800080;
+    uint32_t ag = ((p1 >> 8) & 0x00FF00FF) * (256 - f) + ((p2 >> 8) & 0x00FF00FF) * f + 0x00800080;
+
+    return ((rb >> 8) & 0x00FF00FF) | (ag & 0xFF00FF00);
+}
+
+static inline uint32_t premultiply_pixel(uint32_t p)
+{
+    return (mul_pixel(p, p >> 24) & 0x00FFFFFF) | (p & 0xFF000000);
+}
+
+#if defined(__ARM_NEON)
+// (@x / 255) with rounding for each element of @x that is not larger than 255 * 255
+static inline uint8x8_t div255_u16(uint16x8_t x)
+{
+    x = vaddq_u16(x, vdupq_n_u16(128));
+    return vaddhn_u16(x, vshrq_n_u16(x, 8));
+}
+#endif
+
+/*
+ * Blend @count premultiplied pixels in @src onto @dst with the plane alpha
+ * @alpha: dst = src * alpha + dst * (1 - src.a * alpha)
+ */
+static inline void blend_row_scalar(uint32_t *dst, const uint32_t *src, int32_t count, uint32_t alpha)
+{
+    for (int32_t i = 0; i < count; i++) {
+        uint32_t s = (alpha != 255) ? mul_pixel(src[i], alpha) : src[i];
+        uint32_t sa = s >> 24;
+
+        if (sa == 255)
+            dst[i] = s;
+        else if (s != 0)
+            dst[i] = add_pixel(s, mul_pixel(dst[i], 255 - sa));
+    }
+}
+
+// Same as blend_row_scalar() but by 8 pixels at once with NEON if available
+static inline void blend_row(uint32_t *dst, const uint32_t *src, int32_t count, uint32_t alpha)
+{
+    int32_t i = 0;
+
+#if defined(__ARM_NEON)
+    uint8x8_t plane_alpha = vdup_n_u8(static_cast<uint8_t>(alpha));
+
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t s = vld4_u8(reinterpret_cast<const uint8_t *>(src + i));
+        uint8x8x4_t d = vld4_u8(reinterpret_cast<uint8_t *>(dst + i));
+
+        if (alpha != 255) {
+            for (int c = 0; c < 4; c++)
+                s.val[c] = div255_u16(vmull_u8(s.val[c], plane_alpha));
+        }
+
+        uint8x8_t inv = vmvn_u8(s.val[3]);
+
+        for (int c = 0; c < 4; c++)
+            d.val[c] = vqadd_u8(s.val[c], div255_u16(vmull_u8(d.val[c], inv)));
+
+        vst4_u8(reinterpret_cast<uint8_t *>(dst + i), d);
+    }
+#endif
+
+    blend_row_scalar(dst + i, src + i, count - i, alpha);
+}
+
+/*
+ * How the window of a layer is mapped to its crop area. The position in the
+ * crop area is (@sx, @sy) + (@sx_du, @sy_du) * u + (@sx_dv, @sy_dv) * v for
+ * the pixel (u, v) in the window in 16.16 fixed point.
+ */
+struct CpuSourceMapping {
+    int64_t sx, sy;
+    int64_t sx_du, sy_du;
+    int64_t sx_dv, sy_dv;
+    bool scaled;
+};
+
+static inline int64_t to_fixed16(double val)
+{
+    return static_cast<int64_t>(llround(val * 65536.0));
+}
+
+// @transform is the combination of HAL_TRANSFORM_*
+static inline void get_source_mapping(uint32_t transform, const hw2d_coord_t &crop,
+                                      const hw2d_coord_t &window, CpuSourceMapping &map)
+{
+    double w = window.hori;
+    double h = window.vert;
+    bool rot90 = !!(transform & HAL_TRANSFORM_ROT_90);
+    // the window before rotation
+    double pw = rot90 ? h : w;
+    double ph = rot90 ? w : h;
+    // the position before rotation: (px, py) = p0 + p_du * u + p_dv * v
+    double px0 = 0, px_du = 1, px_dv = 0;
+    double py0 = 0, py_du = 0, py_dv = 1;
+
+    if (rot90) {
+        px0 = 0; px_du = 0; px_dv = 1;
+        py0 = ph; py_du = -1; py_dv = 0;
+    }
+
+    if (!!(transform & HAL_TRANSFORM_FLIP_H)) {
+        px0 = pw - px0; px_du = -px_du; px_dv = -px_dv;
+    }
+
+    if (!!(transform & HAL_TRANSFORM_FLIP_V)) {
+        py0 = ph - py0; py_du = -py_du; py_dv = -py_dv;
+    }
+
+    double kx = crop.hori / pw;
+    double ky = crop.vert / ph;
+
+    // sample at the center of each target pixel
+    map.sx = to_fixed16(kx * (px0 + 0.5 * px_du + 0.5 * px_dv));
+    map.sy = to_fixed16(ky * (py0 + 0.5 * py_du + 0.5 * py_dv));
+    map.sx_du = to_fixed16(kx * px_du);
+    map.sy_du = to_fixed16(ky * py_du);
+    map.sx_dv = to_fixed16(kx * px_dv);
+    map.sy_dv = to_fixed16(ky * py_dv);
+    map.scaled = (crop.hori != pw) || (crop.vert != ph);
+}
+
+#endif //__HARDWARE_EXYNOS_ACRYLIC_CPU_KERNELS_H__
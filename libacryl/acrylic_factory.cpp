@@ -21,6 +21,7 @@
 
 #include <cstring>
 
+#include "acrylic_cpu.h"
 #include "acrylic_g2d.h"
 #include "acrylic_internal.h"
 #include "acrylic_capability.h"
@@ -31,6 +32,8 @@ Acrylic *Acrylic::createInstance(const char *spec)
 
     ALOGD_TEST("Creating a new Acrylic instance of '%s'", spec);
     compositor = createAcrylicCompositorG2D(spec);
+    if (!compositor)
+        compositor = createAcrylicCompositorCPU(spec);
     if (compositor) {
         ALOGI("%s compositor added", spec);
     }
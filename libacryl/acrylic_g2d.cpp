@@ -637,42 +637,25 @@ static lossy_formats sbwc_lossy_formats[] {
 };
 
 
-bool AcrylicCompositorG2D::prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index)
+bool AcrylicCompositorG2D::prepareImageBuffer(AcrylicCanvas &layer, struct g2d_layer &image, unsigned int num_bufs)
 {
-    image.flags = 0;
-
     if (layer.getFence() >= 0) {
         image.flags |= G2D_LAYERFLAG_ACQUIRE_FENCE;
         image.fence = layer.getFence();
     }
 
-    if (layer.isProtected())
-        image.flags |= G2D_LAYERFLAG_SECURE;
-
-    g2d_fmt *g2dfmt = halfmt_to_g2dfmt(halfmt_to_g2dfmt_tbl, len_halfmt_to_g2dfmt_tbl, layer.getFormat());
-    if (!g2dfmt)
-        return false;
-
-    image.flags &= ~G2D_LAYERFLAG_MFC_STRIDE;
-    for (size_t i = 0; i < ARRSIZE(mfc_stride_formats); i++) {
-        if (layer.getFormat() == mfc_stride_formats[i]) {
-            image.flags |= G2D_LAYERFLAG_MFC_STRIDE;
-            break;
-        }
-    }
-
     if (layer.getBufferType() == AcrylicCanvas::MT_EMPTY) {
         image.buffer_type = G2D_BUFTYPE_EMPTY;
     } else {
-        if (layer.getBufferCount() < g2dfmt->num_bufs) {
+        if (layer.getBufferCount() < num_bufs) {
             ALOGE("HAL Format %#x requires %d buffers but %d buffers are given",
-                    layer.getFormat(), g2dfmt->num_bufs, layer.getBufferCount());
+                    layer.getFormat(), num_bufs, layer.getBufferCount());
             return false;
         }
 
         if (layer.getBufferType() == AcrylicCanvas::MT_DMABUF) {
             image.buffer_type = G2D_BUFTYPE_DMABUF;
-            for (unsigned int i = 0; i < g2dfmt->num_bufs; i++) {
+            for (unsigned int i = 0; i < num_bufs; i++) {
                 image.buffer[i].dmabuf.fd = layer.getDmabuf(i);
                 image.buffer[i].dmabuf.offset = layer.getOffset(i);
                 image.buffer[i].length = layer.getBufferLength(i);
@@ -681,14 +664,38 @@ bool AcrylicCompositorG2D::prepareImage(AcrylicCanvas &layer, struct g2d_layer &
             LOGASSERT(layer.getBufferType() == AcrylicCanvas::MT_USERPTR,
                       "Unknown buffer type %d", layer.getBufferType());
             image.buffer_type = G2D_BUFTYPE_USERPTR;
-            for (unsigned int i = 0; i < g2dfmt->num_bufs; i++) {
+            for (unsigned int i = 0; i < num_bufs; i++) {
                 image.buffer[i].userptr = layer.getUserptr(i);
                 image.buffer[i].length = layer.getBufferLength(i);
             }
         }
     }
 
-    image.num_buffers = g2dfmt->num_bufs;
+    image.num_buffers = num_bufs;
+
+    return true;
+}
+
+bool AcrylicCompositorG2D::prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index)
+{
+    image.flags = 0;
+
+    if (layer.isProtected())
+        image.flags |= G2D_LAYERFLAG_SECURE;
+
+    g2d_fmt *g2dfmt = halfmt_to_g2dfmt(halfmt_to_g2dfmt_tbl, len_halfmt_to_g2dfmt_tbl, layer.getFormat());
+    if (!g2dfmt)
+        return false;
+
+    for (size_t i = 0; i < ARRSIZE(mfc_stride_formats); i++) {
+        if (layer.getFormat() == mfc_stride_formats[i]) {
+            image.flags |= G2D_LAYERFLAG_MFC_STRIDE;
+            break;
+        }
+    }
+
+    if (!prepareImageBuffer(layer, image, g2dfmt->num_bufs))
+        return false;
 
     hw2d_coord_t xy = layer.getImageDimension();
 
@@ -976,11 +983,82 @@ bool AcrylicCompositorG2D::prepareSource(AcrylicLayer &layer, struct g2d_layer &
     return true;
 }
 
+void AcrylicCompositorG2D::makeCommandCacheKey(AcrylicCanvas &canvas, CommandCacheKey &key)
+{
+    memset(&key, 0, sizeof(key));
+
+    key.format = canvas.getFormat();
+    key.attributes = (canvas.isProtected() ? AcrylicCanvas::ATTR_PROTECTED : 0) |
+                     (canvas.isCompressed() ? AcrylicCanvas::ATTR_COMPRESSED : 0) |
+                     (canvas.isCompressedWideblk() ? AcrylicCanvas::ATTR_COMPRESSED_WIDEBLK : 0) |
+                     (canvas.isUOrder() ? AcrylicCanvas::ATTR_UORDER : 0) |
+                     (canvas.isSolidColor() ? AcrylicCanvas::ATTR_SOLIDCOLOR : 0);
+    key.bufferType = canvas.getBufferType();
+    key.bufferCount = canvas.getBufferCount();
+    key.dimension = canvas.getImageDimension();
+    key.index = ~0U;
+}
+
+void AcrylicCompositorG2D::makeCommandCacheKey(AcrylicLayer &layer, hw2d_coord_t target_size,
+                                               unsigned int index, unsigned int image_index,
+                                               CommandCacheKey &key)
+{
+    makeCommandCacheKey(layer, key);
+
+    key.imageRect = layer.getImageRect();
+    key.targetRect = layer.getTargetRect();
+    key.targetSize = target_size;
+    key.transform = layer.getTransform();
+    key.blending = layer.getCompositingMode();
+    key.solidColor = layer.getSolidColor();
+    key.alpha = layer.getPlaneAlpha();
+    key.index = index;
+    key.imageIndex = image_index;
+}
+
+bool AcrylicCompositorG2D::loadCommandCache(CommandCache &cache, const CommandCacheKey &key,
+                                            AcrylicCanvas &canvas, struct g2d_layer &image,
+                                            uint32_t cmd[], unsigned int cmd_count)
+{
+    // The format and the dimension are already in the key but their
+    // modification flags save the comparison when they have changed.
+    if (!cache.valid ||
+        !!(canvas.getSettingFlags() & (AcrylicCanvas::SETTING_TYPE_MODIFIED |
+                                       AcrylicCanvas::SETTING_DIMENSION_MODIFIED)) ||
+        (memcmp(&cache.key, &key, sizeof(key)) != 0))
+        return false;
+
+    image = cache.image;
+    memcpy(cmd, cache.cmd, sizeof(*cmd) * cmd_count);
+
+    // Only the buffers and the acquire fence can be different from the cached image.
+    if (image.flags & G2D_LAYERFLAG_COLORFILL)
+        return true;
+
+    return prepareImageBuffer(canvas, image, image.num_buffers);
+}
+
+void AcrylicCompositorG2D::storeCommandCache(CommandCache &cache, const CommandCacheKey &key,
+                                             const struct g2d_layer &image, const uint32_t cmd[],
+                                             unsigned int cmd_count)
+{
+    cache.key = key;
+    cache.image = image;
+    cache.image.flags &= ~G2D_LAYERFLAG_ACQUIRE_FENCE;
+    cache.image.fence = -1;
+    memcpy(cache.cmd, cmd, sizeof(*cmd) * cmd_count);
+    cache.valid = true;
+}
+
 bool AcrylicCompositorG2D::reallocLayer(unsigned int layercount)
 {
     if (mMaxSourceCount >= layercount)
         return true;
 
+    mTargetCache.valid = false;
+    mSourceCache.clear();
+    mSourceCache.resize(layercount);
+
     if (!mTask.commands.target) {
         mTask.commands.target = new uint32_t[G2DSFR_DST_FIELD_COUNT];
         if (!mTask.commands.target) {
@@ -1060,6 +1138,8 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
     if (!validateAllLayers())
         return false;
 
+    mPerfModel.collectSamples();
+
     unsigned int layercount = layerCount();
 
     // Set invalid fence fd to the entries exceeds the number of source and destination images
@@ -1091,9 +1171,17 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
 
     mTask.flags = 0;
 
-    if (!prepareImage(getCanvas(), mTask.target, mTask.commands.target, -1)) {
-        ALOGE("Failed to configure the target image");
-        return false;
+    CommandCacheKey key;
+
+    makeCommandCacheKey(getCanvas(), key);
+    if (!loadCommandCache(mTargetCache, key, getCanvas(), mTask.target,
+                          mTask.commands.target, G2DSFR_DST_FIELD_COUNT)) {
+        if (!prepareImage(getCanvas(), mTask.target, mTask.commands.target, -1)) {
+            ALOGE("Failed to configure the target image");
+            return false;
+        }
+        storeCommandCache(mTargetCache, key, mTask.target,
+                          mTask.commands.target, G2DSFR_DST_FIELD_COUNT);
     }
 
     if (getCanvas().isOTF())
@@ -1117,11 +1205,17 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
     for (unsigned int i = baseidx; i < layercount; i++) {
         AcrylicLayer &layer = *getLayer(i - baseidx);
 
-        if (!prepareSource(layer, mTask.source[i],
-                           mTask.commands.source[i], getCanvas().getImageDimension(),
-                           i, i - baseidx)) {
-            ALOGE("Failed to configure source layer %u", i - baseidx);
-            return false;
+        makeCommandCacheKey(layer, getCanvas().getImageDimension(), i, i - baseidx, key);
+        if (!loadCommandCache(mSourceCache[i], key, layer, mTask.source[i],
+                              mTask.commands.source[i], G2DSFR_SRC_FIELD_COUNT)) {
+            if (!prepareSource(layer, mTask.source[i],
+                               mTask.commands.source[i], getCanvas().getImageDimension(),
+                               i, i - baseidx)) {
+                ALOGE("Failed to configure source layer %u", i - baseidx);
+                return false;
+            }
+            storeCommandCache(mSourceCache[i], key, mTask.source[i],
+                              mTask.commands.source[i], G2DSFR_SRC_FIELD_COUNT);
         }
 
         if (!cscMatrixWriter.configure(mTask.commands.source[i][G2DSFR_IMG_COLORMODE],
@@ -1189,6 +1283,19 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
         return false;
     }
 
+    if (!nonblocking) {
+        mPerfModel.addSample(layerCount(), getTaskCost(), mTask.laptime_in_usec);
+    } else {
+        int *acquire_fences = reinterpret_cast<int *>(alloca(sizeof(int) * (layerCount() + 1)));
+
+        for (unsigned int i = 0; i < layerCount(); i++)
+            acquire_fences[i] = getLayer(i)->getFence();
+        acquire_fences[layerCount()] = getCanvas().getFence();
+
+        mPerfModel.trackTask((num_fences > layerCount()) ? mTask.release_fence[layerCount()] : -1,
+                             acquire_fences, layerCount() + 1, layerCount(), getTaskCost());
+    }
+
     getCanvas().clearSettingModified();
     getCanvas().setFence(-1);
 
@@ -1203,6 +1310,64 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
     return true;
 }
 
+/*
+ * The amount of data read from a source image in bits weighted by 16, or by 18
+ * when scaling is involved.
+ */
+static uint64_t g2d_layer_read_cost(const hw2d_rect_t &crop, const hw2d_coord_t &window,
+                                    uint32_t halfmt, uint32_t transform)
+{
+    // Src layer crop size is used when calculating read bandwidth.
+    // Crop coordinates should be aligned in multiples of 16.
+    uint64_t layer_bw = (ALIGN(crop.pos.hori + crop.size.hori, 16) - ALIGN_DOWN(crop.pos.hori, 16)) *
+                        (ALIGN(crop.pos.vert + crop.size.vert, 16) - ALIGN_DOWN(crop.pos.vert, 16));
+    int32_t is_scaling;
+
+    layer_bw *= halfmt_bpp(halfmt);
+
+    // Below is checking if scaling is involved.
+    // Comparisons are replaced by additions to avoid branches.
+    if (!!(transform & HAL_TRANSFORM_ROT_90)) {
+        is_scaling = crop.size.hori - window.vert;
+        is_scaling += crop.size.vert - window.hori;
+    } else {
+        is_scaling = crop.size.hori - window.hori;
+        is_scaling += crop.size.vert - window.vert;
+    }
+    // Weight to the bandwidth when scaling is involved is 1.125.
+    // It is multiplied by 16 to avoid multiplication with a real number.
+    // We also get benefit from shift instead of multiplication.
+    if (is_scaling == 0)
+        return layer_bw << 4; // layer_bw * 16
+
+    return (layer_bw << 4) + (layer_bw << 1); // layer_bw * 18
+}
+
+uint64_t AcrylicCompositorG2D::getTaskCost()
+{
+    hw2d_coord_t target_size = getCanvas().getImageDimension();
+    uint64_t cost = target_size.hori * target_size.vert;
+
+    // The same cost of a frame as requestPerformanceQoS()
+    cost = (cost * halfmt_bpp(getCanvas().getFormat())) << 4;
+
+    for (unsigned int i = 0; i < layerCount(); i++) {
+        AcrylicLayer &layer = *getLayer(i);
+
+        if (layer.isSolidColor())
+            continue;
+
+        hw2d_rect_t target_rect = layer.getTargetRect();
+        if (area_is_zero(target_rect))
+            target_rect.size = target_size;
+
+        cost += g2d_layer_read_cost(layer.getImageRect(), target_rect.size,
+                                    layer.getFormat(), layer.getTransform());
+    }
+
+    return cost;
+}
+
 bool AcrylicCompositorG2D::execute(int fence[], unsigned int num_fences)
 {
     if (!executeG2D(fence, num_fences, true)) {
@@ -1255,10 +1420,14 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
             return false;
         }
 
+        mPerfModel.setAppliedScale(0);
+
         ALOGD_TEST("Canceled performance request");
         return true;
     }
 
+    uint32_t max_scale = 0;
+
     ALOGD_TEST("Requesting performance: frame count %d:", request->getFrameCount());
     for (int i = 0; i < request->getFrameCount(); i++) {
         AcrylicPerformanceRequestFrame *frame = request->getFrame(i);
@@ -1274,8 +1443,7 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
         uint32_t equiv_fmt;
         for (int idx = 0; idx < frame->getLayerCount(); idx++) {
             AcrylicPerformanceRequestLayer *layer = &(frame->mLayers[idx]);
-            uint64_t layer_bw, pixelcount;
-            int32_t is_scaling;
+            uint64_t layer_bw;
             uint32_t src_hori = layer->mSourceRect.size.hori;
             uint32_t src_vert = layer->mSourceRect.size.vert;
             uint32_t dst_hori = layer->mTargetRect.size.hori;
@@ -1285,13 +1453,6 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
             data.frame[i].layer[idx].window_width = dst_hori;
             data.frame[i].layer[idx].window_height = dst_vert;
 
-            // Src layer crop size is used when calculating read bandwidth.
-            // Crop coordinates should be aligned in multiples of 16.
-            pixelcount = (ALIGN(layer->mSourceRect.pos.hori + src_hori, 16) -
-                          ALIGN_DOWN(layer->mSourceRect.pos.hori, 16)) *
-                         (ALIGN(layer->mSourceRect.pos.vert + src_vert, 16) -
-                          ALIGN_DOWN(layer->mSourceRect.pos.vert, 16));
-
             bpp = halfmt_bpp(layer->mPixFormat);
             planecount = halfmt_plane_count(layer->mPixFormat);
             equiv_fmt = find_format_equivalent(layer->mPixFormat);
@@ -1310,28 +1471,14 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
             // src_yuv420_8b is used when calculating write bandwidth
             if (bpp == 12) src_yuv420_8b = true;
 
-            layer_bw = pixelcount * bpp;
-            // Below is checking if scaling is involved.
-            // Comparisons are replaced by additions to avoid branches.
             if (!!(layer->mTransform & HAL_TRANSFORM_ROT_90)) {
                 src_rotate = true;
                 data.frame[i].layer[idx].layer_attr |= G2D_PERF_LAYER_ROTATE;
-
-                is_scaling = src_hori - dst_vert;
-                is_scaling += src_vert - dst_hori;
-            } else {
-                is_scaling = src_hori - dst_hori;
-                is_scaling += src_vert - dst_vert;
-            }
-            // Weight to the bandwidth when scaling is involved is 1.125.
-            // It is multiplied by 16 to avoid multiplication with a real number.
-            // We also get benefit from shift instead of multiplication.
-            if (is_scaling == 0) {
-                layer_bw <<= 4; // layer_bw * 16
-            } else {
-                layer_bw = (layer_bw << 4) + (layer_bw << 1); // layer_bw * 18
             }
 
+            layer_bw = g2d_layer_read_cost(layer->mSourceRect, layer->mTargetRect.size,
+                                           layer->mPixFormat, layer->mTransform);
+
             bandwidth += layer_bw;
             ALOGD_TEST("        LAYER[%d]: BW %llu FMT %#x(%u) (%dx%d)@(%dx%d)on(%dx%d) --> (%dx%d)@(%dx%d) TRFM %#x",
                     idx, static_cast<unsigned long long>(layer_bw), layer->mPixFormat, bpp,
@@ -1342,14 +1489,26 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
                     layer->mTargetRect.pos.hori, layer->mTargetRect.pos.vert, layer->mTransform);
         }
 
+        bpp = halfmt_bpp(frame->mTargetPixFormat);
+
+        uint64_t target_bw = frame->mTargetDimension.hori * frame->mTargetDimension.vert;
+        target_bw *= bpp;
+
+        // The bandwidth is scaled for the frame to complete in time according
+        // to the processing time measured for the recent tasks.
+        uint32_t scale = mPerfModel.getBandwidthScale(frame->getLayerCount(),
+                                                      bandwidth + (target_bw << 4),
+                                                      frame->mFrameRate);
+        max_scale = std::max(max_scale, scale);
+
         bandwidth *= frame->mFrameRate;
+        bandwidth = (bandwidth * scale) / AcrylicPerformanceModel::SCALE_ONE;
         bandwidth >>= 17; // divide by 16(weight), 8(bpp) and 1024(kilobyte)
 
         data.frame[i].bandwidth_read = static_cast<uint32_t>(bandwidth);
 
-        bpp = halfmt_bpp(frame->mTargetPixFormat);
-        bandwidth = frame->mTargetDimension.hori * frame->mTargetDimension.vert;
-        bandwidth *= frame->mFrameRate * bpp;
+        bandwidth = target_bw * frame->mFrameRate;
+        bandwidth = (bandwidth * scale) / AcrylicPerformanceModel::SCALE_ONE;
 
         // When src rotation is involved, src format includes yuv420(8bit-depth)
         // and dst format is yuv420(8bit-depth), weight to the write bandwidth is 2.
@@ -1378,6 +1537,8 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
         return false;
     }
 
+    mPerfModel.setAppliedScale(max_scale);
+
     return true;
 }
 
@@ -19,6 +19,7 @@
 #define __HARDWARE_EXYNOS_HW2DCOMPOSITOR_G2D_H__
 
 #include <memory>
+#include <vector>
 
 #include <hardware/exynos/acryl.h>
 
@@ -28,6 +29,7 @@
 
 #include "acrylic_internal.h"
 #include "acrylic_device.h"
+#include "acrylic_performance.h"
 
 class G2DHdrWriter {
     std::unique_ptr<IG2DHdr10CommandWriter> mWriter;
@@ -134,8 +136,52 @@ public:
     virtual int prioritize(int priority = -1);
     virtual bool requestPerformanceQoS(AcrylicPerformanceRequest *request);
 private:
+    /*
+     * The configuration of an image that its commands are made from.
+     * Buffers and fences are not part of it.
+     */
+    struct CommandCacheKey {
+        uint32_t format;
+        uint32_t attributes;
+        uint32_t bufferType;
+        uint32_t bufferCount;
+        hw2d_coord_t dimension;
+        hw2d_rect_t imageRect;
+        hw2d_rect_t targetRect;
+        hw2d_coord_t targetSize;
+        uint32_t transform;
+        uint32_t blending;
+        uint32_t solidColor;
+        uint32_t alpha;
+        uint32_t index;
+        uint32_t imageIndex;
+    };
+    /*
+     * The image descriptor and the commands of the target or a source image
+     * before CSC and HDR settings are applied. They are reused while the
+     * configuration of the image does not change between executions.
+     */
+    struct CommandCache {
+        static constexpr unsigned int COMMAND_COUNT =
+                (G2DSFR_SRC_FIELD_COUNT > G2DSFR_DST_FIELD_COUNT) ? G2DSFR_SRC_FIELD_COUNT
+                                                                  : G2DSFR_DST_FIELD_COUNT;
+        bool valid = false;
+        CommandCacheKey key;
+        g2d_layer image;
+        uint32_t cmd[COMMAND_COUNT];
+    };
+
     int ioctlG2D(void);
     bool executeG2D(int fence[], unsigned int num_fences, bool nonblocking);
+    uint64_t getTaskCost();
+    void makeCommandCacheKey(AcrylicCanvas &canvas, CommandCacheKey &key);
+    void makeCommandCacheKey(AcrylicLayer &layer, hw2d_coord_t target_size, unsigned int index,
+                             unsigned int image_index, CommandCacheKey &key);
+    bool loadCommandCache(CommandCache &cache, const CommandCacheKey &key, AcrylicCanvas &canvas,
+                          struct g2d_layer &image, uint32_t cmd[], unsigned int cmd_count);
+    void storeCommandCache(CommandCache &cache, const CommandCacheKey &key,
+                           const struct g2d_layer &image, const uint32_t cmd[], unsigned int cmd_count);
+    bool prepareImageBuffer(AcrylicCanvas &layer, struct g2d_layer &image, unsigned int num_bufs);
     bool prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index);
     bool prepareSource(AcrylicLayer &layer, struct g2d_layer &image, uint32_t cmd[], hw2d_coord_t target_size,
                        unsigned int index, unsigned int image_index);
@@ -147,6 +193,9 @@ private:
     AcrylicDevice mDev;
     g2d_task	  mTask;
     G2DHdrWriter  mHdrWriter;
+    CommandCache  mTargetCache;
+    std::vector<CommandCache> mSourceCache;
+    AcrylicPerformanceModel mPerfModel;
     unsigned int  mMaxSourceCount;
     int mPriority;
     unsigned int mVersion;
@@ -14,11 +14,20 @@
  * limitations under the License.
  */
 
+#include <linux/sync_file.h>
 #include <log/log.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 
 #include <hardware/exynos/acryl.h>
 
 #include "acrylic_internal.h"
+#include "acrylic_performance.h"
 
 AcrylicPerformanceRequest::AcrylicPerformanceRequest()
     : mNumFrames(0), mNumAllocFrames(0), mFrames(NULL)
@@ -82,3 +91,288 @@ bool AcrylicPerformanceRequestFrame::reset(int num_layers)
 
     return true;
 }
+
+// The number of samples to collect before the fit is used
+#define PERF_MODEL_MIN_SAMPLES      8
+// The weight of a sample is multiplied by this for every new sample
+#define PERF_MODEL_FORGET_FACTOR    0.97
+// The tasks of a frame should complete in this percent of the frame period
+#define PERF_MODEL_DEADLINE_PERCENT 50
+// The range of the bandwidth scale against the static bandwidth
+#define PERF_MODEL_MIN_SCALE        (AcrylicPerformanceModel::SCALE_ONE / 4)
+#define PERF_MODEL_MAX_SCALE        (AcrylicPerformanceModel::SCALE_ONE * 2)
+
+static inline int64_t perf_model_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The variables of the fit: constant, the number of layers and cost in Mi units
+static inline void perf_model_variables(unsigned int layer_count, uint64_t cost, double x[3])
+{
+    x[0] = 1.0;
+    x[1] = layer_count;
+    x[2] = static_cast<double>(cost) / (1 << 20);
+}
+
+// Query if @fence is signaled. The signal time is stored to @timestamp_ns
+// when a positive value is returned. 0 means not signaled, negative an error.
+static int perf_model_fence_status(int fence, int64_t *timestamp_ns)
+{
+    struct sync_fence_info fence_info;
+    struct sync_file_info info;
+
+    memset(&fence_info, 0, sizeof(fence_info));
+    memset(&info, 0, sizeof(info));
+    info.num_fences = 1;
+    info.sync_fence_info = reinterpret_cast<uint64_t>(&fence_info);
+
+    if (ioctl(fence, SYNC_IOC_FILE_INFO, &info) < 0) {
+        ALOGERR("Failed to get the status of fence %d", fence);
+        return -1;
+    }
+
+    if (info.status > 0)
+        *timestamp_ns = static_cast<int64_t>(fence_info.timestamp_ns);
+
+    return info.status;
+}
+
+AcrylicPerformanceModel::AcrylicPerformanceModel()
+    : mSampleCount(0), mAppliedScale(0), mTrackedCount(0), mLastCompletionNs(0),
+      mUnknownCompletion(false)
+{
+    memset(mAtA, 0, sizeof(mAtA));
+    memset(mAtb, 0, sizeof(mAtb));
+}
+
+AcrylicPerformanceModel::~AcrylicPerformanceModel()
+{
+    while (mTrackedCount > 0)
+        untrackTask(0);
+}
+
+void AcrylicPerformanceModel::addSample(unsigned int layer_count, uint64_t cost, uint64_t laptime_usec)
+{
+    if (laptime_usec > 0)
+        addSample(layer_count, cost, laptime_usec, mAppliedScale);
+}
+
+void AcrylicPerformanceModel::addSample(unsigned int layer_count, uint64_t cost,
+                                        uint64_t laptime_usec, uint32_t scale)
+{
+    if (scale == 0)
+        return;
+
+    double x[NUM_COEFFICIENTS];
+    // the processing time under the static bandwidth
+    double y = static_cast<double>(laptime_usec) * scale / SCALE_ONE;
+
+    perf_model_variables(layer_count, cost, x);
+
+    for (int i = 0; i < NUM_COEFFICIENTS; i++) {
+        for (int j = 0; j < NUM_COEFFICIENTS; j++)
+            mAtA[i][j] = mAtA[i][j] * PERF_MODEL_FORGET_FACTOR + x[i] * x[j];
+        mAtb[i] = mAtb[i] * PERF_MODEL_FORGET_FACTOR + x[i] * y;
+    }
+
+    mSampleCount++;
+
+    ALOGD_TEST("Performance sample: %u layers, cost %llu, %llu usec at scale %u",
+               layer_count, static_cast<unsigned long long>(cost),
+               static_cast<unsigned long long>(laptime_usec), scale);
+}
+
+void AcrylicPerformanceModel::untrackTask(unsigned int index)
+{
+    close(mTrackedTasks[index].fence);
+    for (auto fence: mTrackedTasks[index].acquireFences)
+        close(fence);
+
+    mTrackedCount--;
+    for (unsigned int i = index; i < mTrackedCount; i++)
+        mTrackedTasks[i] = std::move(mTrackedTasks[i + 1]);
+    mTrackedTasks[mTrackedCount].acquireFences.clear();
+}
+
+// The completion time of the task before the one at @index is not known
+void AcrylicPerformanceModel::forgetCompletion(unsigned int index)
+{
+    if (index < mTrackedCount)
+        mTrackedTasks[index].unknownStart = true;
+    else
+        mUnknownCompletion = true;
+}
+
+void AcrylicPerformanceModel::trackTask(int release_fence, const int acquire_fences[],
+                                        unsigned int num_acquire_fences,
+                                        unsigned int layer_count, uint64_t cost)
+{
+    if ((release_fence < 0) || (mAppliedScale == 0)) {
+        forgetCompletion(mTrackedCount);
+        return;
+    }
+
+    // Forget the oldest task that has not completed for long
+    if (mTrackedCount == MAX_TRACKED_TASKS) {
+        untrackTask(0);
+        forgetCompletion(0);
+    }
+
+    int fence = dup(release_fence);
+    if (fence < 0) {
+        ALOGERR("Failed to duplicate release fence %d", release_fence);
+        forgetCompletion(mTrackedCount);
+        return;
+    }
+
+    TrackedTask &task = mTrackedTasks[mTrackedCount++];
+
+    task.fence = fence;
+    task.layerCount = layer_count;
+    task.cost = cost;
+    task.scale = mAppliedScale;
+    task.startTimeNs = perf_model_now_ns();
+    task.acquireFences.clear();
+    task.unknownStart = mUnknownCompletion;
+    mUnknownCompletion = false;
+
+    for (unsigned int i = 0; !task.unknownStart && (i < num_acquire_fences); i++) {
+        int64_t timestamp;
+
+        if (acquire_fences[i] < 0)
+            continue;
+
+        int status = perf_model_fence_status(acquire_fences[i], &timestamp);
+        if (status > 0) {
+            task.startTimeNs = std::max(task.startTimeNs, timestamp);
+        } else if (status < 0) {
+            task.unknownStart = true;
+        } else {
+            // signaled after now: its time is known when the task completes
+            fence = dup(acquire_fences[i]);
+            if (fence < 0) {
+                ALOGERR("Failed to duplicate acquire fence %d", acquire_fences[i]);
+                task.unknownStart = true;
+            } else {
+                task.acquireFences.push_back(fence);
+            }
+        }
+    }
+}
+
+void AcrylicPerformanceModel::collectSamples()
+{
+    // The tasks complete in the order of submission. Each task starts after
+    // the previous one completes at the earliest.
+    while (mTrackedCount > 0) {
+        TrackedTask &task = mTrackedTasks[0];
+        int64_t timestamp;
+
+        int status = perf_model_fence_status(task.fence, &timestamp);
+        if (status == 0)
+            break;
+
+        if (status < 0) {
+            untrackTask(0);
+            forgetCompletion(0);
+            continue;
+        }
+
+        int64_t start = std::max(task.startTimeNs, mLastCompletionNs);
+
+        for (auto fence: task.acquireFences) {
+            int64_t signaled;
+
+            if (perf_model_fence_status(fence, &signaled) > 0)
+                start = std::max(start, signaled);
+            else
+                task.unknownStart = true;
+        }
+
+        mLastCompletionNs = timestamp;
+
+        // normalized with the scale applied when the task was submitted
+        if (!task.unknownStart && (timestamp > start))
+            addSample(task.layerCount, task.cost, (timestamp - start) / 1000, task.scale);
+
+        untrackTask(0);
+    }
+}
+
+bool AcrylicPerformanceModel::solve(double coef[NUM_COEFFICIENTS])
+{
+    double m[NUM_COEFFICIENTS][NUM_COEFFICIENTS + 1];
+    double trace = 0;
+
+    for (int i = 0; i < NUM_COEFFICIENTS; i++)
+        trace += mAtA[i][i];
+
+    // A little regularization keeps the equations solvable when a variable
+    // does not change at all, e.g. the number of layers.
+    for (int i = 0; i < NUM_COEFFICIENTS; i++) {
+        for (int j = 0; j < NUM_COEFFICIENTS; j++)
+            m[i][j] = mAtA[i][j];
+        m[i][i] += trace * 1e-9 + 1e-12;
+        m[i][NUM_COEFFICIENTS] = mAtb[i];
+    }
+
+    for (int col = 0; col < NUM_COEFFICIENTS; col++) {
+        int pivot = col;
+
+        for (int row = col + 1; row < NUM_COEFFICIENTS; row++) {
+            if (fabs(m[row][col]) > fabs(m[pivot][col]))
+                pivot = row;
+        }
+
+        if (fabs(m[pivot][col]) < 1e-12)
+            return false;
+
+        for (int j = 0; j <= NUM_COEFFICIENTS; j++)
+            std::swap(m[col][j], m[pivot][j]);
+
+        for (int row = 0; row < NUM_COEFFICIENTS; row++) {
+            if (row == col)
+                continue;
+
+            double factor = m[row][col] / m[col][col];
+            for (int j = col; j <= NUM_COEFFICIENTS; j++)
+                m[row][j] -= factor * m[col][j];
+        }
+    }
+
+    for (int i = 0; i < NUM_COEFFICIENTS; i++)
+        coef[i] = m[i][NUM_COEFFICIENTS] / m[i][i];
+
+    return true;
+}
+
+uint32_t AcrylicPerformanceModel::getBandwidthScale(unsigned int layer_count, uint64_t cost, int frame_rate)
+{
+    if ((mSampleCount < PERF_MODEL_MIN_SAMPLES) || (frame_rate <= 0))
+        return SCALE_ONE;
+
+    double coef[NUM_COEFFICIENTS];
+    if (!solve(coef))
+        return SCALE_ONE;
+
+    double x[NUM_COEFFICIENTS];
+    double laptime = 0;
+
+    perf_model_variables(layer_count, cost, x);
+    for (int i = 0; i < NUM_COEFFICIENTS; i++)
+        laptime += coef[i] * x[i];
+
+    if (laptime <= 0)
+        return SCALE_ONE;
+
+    double deadline = 1000000.0 / frame_rate * PERF_MODEL_DEADLINE_PERCENT / 100;
+    double scale = laptime / deadline * SCALE_ONE;
+
+    ALOGD_TEST("Performance model: %.1f + %.1f * layers + %.3f * cost(Mi) = %.0f usec, deadline %.0f usec",
+               coef[0], coef[1], coef[2], laptime, deadline);
+
+    return static_cast<uint32_t>(std::min(std::max(scale, static_cast<double>(PERF_MODEL_MIN_SCALE)),
+                                          static_cast<double>(PERF_MODEL_MAX_SCALE)));
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_ACRYLIC_PERFORMANCE_H__
+#define __HARDWARE_EXYNOS_ACRYLIC_PERFORMANCE_H__
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * AcrylicPerformanceModel - Estimation of the processing time of tasks
+ *
+ * It fits the processing time measured for the tasks to the number of layers
+ * and the cost of each task. The cost is the weighted amount of data read and
+ * written by a task which already reflects the formats, the compression and
+ * the scaling of the layers. The processing time is normalized to the time
+ * under the static performance request, assuming that it is inversely
+ * proportional to the requested bandwidth. Recent samples are weighted more
+ * so that the fit follows the changes of the system.
+ * Then, it tells how much the static bandwidth should be scaled for the tasks
+ * of a frame to complete by the deadline with the least bandwidth.
+ */
+class AcrylicPerformanceModel {
+public:
+    /* The value of getBandwidthScale() to keep the static bandwidth */
+    enum { SCALE_ONE = 1024 };
+
+    AcrylicPerformanceModel();
+    ~AcrylicPerformanceModel();
+    /*
+     * Add the processing time @laptime_usec of a blocking task completed
+     * while the bandwidth scale of the current request is applied. Zero
+     * @laptime_usec means that the time is not known and no sample is added.
+     */
+    void addSample(unsigned int layer_count, uint64_t cost, uint64_t laptime_usec);
+    /*
+     * Measure the processing time of a nonblocking task until @release_fence
+     * is signaled. The time starts at the latest of now, the signal of
+     * @acquire_fences and the completion of the previous task so that the
+     * wait for the fences and for the H/W are not counted. @release_fence
+     * and @acquire_fences are duplicated. Call trackTask() with -1 for
+     * @release_fence for the tasks without a release fence so that the task
+     * after them is not measured.
+     */
+    void trackTask(int release_fence, const int acquire_fences[], unsigned int num_acquire_fences,
+                   unsigned int layer_count, uint64_t cost);
+    /*
+     * Add the samples of the tracked tasks that have completed.
+     */
+    void collectSamples();
+    /*
+     * Obtain the bandwidth scale in the unit of SCALE_ONE for a frame of
+     * @layer_count layers and @cost to complete in its deadline at
+     * @frame_rate. SCALE_ONE is returned until the model has enough samples.
+     */
+    uint32_t getBandwidthScale(unsigned int layer_count, uint64_t cost, int frame_rate);
+    /*
+     * Inform the bandwidth scale of the request given to the driver. 0 means
+     * that no request is given and the samples are not normalizable.
+     */
+    void setAppliedScale(uint32_t scale) { mAppliedScale = scale; }
+private:
+    enum { NUM_COEFFICIENTS = 3, MAX_TRACKED_TASKS = 4 };
+
+    struct TrackedTask {
+        int fence;
+        unsigned int layerCount;
+        uint64_t cost;
+        uint32_t scale;
+        /* the latest known time the task could start */
+        int64_t startTimeNs;
+        /* duplicated acquire fences not signaled at submission */
+        std::vector<int> acquireFences;
+        /* the task has waited for a task of unknown completion time */
+        bool unknownStart;
+    };
+
+    void addSample(unsigned int layer_count, uint64_t cost, uint64_t laptime_usec, uint32_t scale);
+    bool solve(double coef[NUM_COEFFICIENTS]);
+    void untrackTask(unsigned int index);
+    void forgetCompletion(unsigned int index);
+
+    /* weighted sums of the normal equations of least squares */
+    double mAtA[NUM_COEFFICIENTS][NUM_COEFFICIENTS];
+    double mAtb[NUM_COEFFICIENTS];
+    unsigned int mSampleCount;
+    uint32_t mAppliedScale;
+    TrackedTask mTrackedTasks[MAX_TRACKED_TASKS];
+    unsigned int mTrackedCount;
+    /* the time the last collected task completed */
+    int64_t mLastCompletionNs;
+    /* the next tracked task may wait for a task of unknown completion time */
+    bool mUnknownCompletion;
+};
+
+#endif //__HARDWARE_EXYNOS_ACRYLIC_PERFORMANCE_H__
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "acrylic_cpu_kernels.h"
+
+static uint32_t channel(uint32_t p, unsigned int c)
+{
+    return (p >> (c * 8)) & 0xFF;
+}
+
+static uint32_t splat(uint32_t c)
+{
+    return c * 0x01010101;
+}
+
+TEST(AcrylicCpuKernels, MulPixel)
+{
+    for (uint32_t a = 0; a < 256; a++) {
+        for (uint32_t c = 0; c < 256; c++) {
+            uint32_t p = mul_pixel(splat(c), a);
+            uint32_t expected = static_cast<uint32_t>(lround(c * a / 255.0));
+
+            for (unsigned int i = 0; i < 4; i++)
+                ASSERT_EQ(expected, channel(p, i)) << "c " << c << " a " << a << " channel " << i;
+        }
+    }
+
+    EXPECT_EQ(0x04030201U, mul_pixel(0x04030201, 255));
+    EXPECT_EQ(0U, mul_pixel(0xFFFFFFFF, 0));
+}
+
+TEST(AcrylicCpuKernels, AddPixel)
+{
+    for (uint32_t c1 = 0; c1 < 256; c1++) {
+        for (uint32_t c2 = 0; c2 < 256; c2++) {
+            uint32_t p = add_pixel(splat(c1), splat(c2));
+
+            ASSERT_EQ(splat(std::min(c1 + c2, 255U)), p) << "c1 " << c1 << " c2 " << c2;
+        }
+    }
+
+    // saturation should not overflow to the neighboring channels
+    EXPECT_EQ(0xFF00FF00U, add_pixel(0xFF00FF00, 0x01000100));
+    EXPECT_EQ(0x00FF00FFU, add_pixel(0x00FF00FF, 0x00010001));
+    EXPECT_EQ(0x80FF40FFU, add_pixel(0x40F020F0, 0x40102010));
+}
+
+TEST(AcrylicCpuKernels, LerpPixel)
+{
+    const uint32_t p1 = 0x10FF8000;
+    const uint32_t p2 = 0xF000FF80;
+
+    EXPECT_EQ(p1, lerp_pixel(p1, p2, 0));
+    EXPECT_EQ(p2, lerp_pixel(p1, p2, 256));
+
+    for (uint32_t f = 0; f <= 256; f++) {
+        uint32_t p = lerp_pixel(p1, p2, f);
+
+        for (unsigned int i = 0; i < 4; i++) {
+            uint32_t expected = (channel(p1, i) * (256 - f) + channel(p2, i) * f + 128) >> 8;
+            ASSERT_EQ(expected, channel(p, i)) << "f " << f << " channel " << i;
+        }
+    }
+}
+
+TEST(AcrylicCpuKernels, BlendRow)
+{
+    const int32_t count = 67; // not a multiple of the NEON width
+    std::vector<uint32_t> src(count);
+    std::vector<uint32_t> dst(count);
+
+    srand(1);
+
+    for (int32_t i = 0; i < count; i++) {
+        uint32_t a = (i % 4 == 0) ? 255 : (i % 4 == 1) ? 0 : rand() % 256;
+        uint32_t p = a << 24;
+
+        // premultiplied: no color channel is larger than alpha
+        for (unsigned int c = 0; c < 3; c++)
+            p |= ((a == 0) ? 0 : rand() % (a + 1)) << (c * 8);
+
+        src[i] = p;
+        dst[i] = rand() | (rand() << 16);
+    }
+
+    for (uint32_t alpha : {255U, 254U, 128U, 17U, 0U}) {
+        std::vector<uint32_t> expected(dst);
+        std::vector<uint32_t> result(dst);
+
+        blend_row_scalar(expected.data(), src.data(), count, alpha);
+        blend_row(result.data(), src.data(), count, alpha);
+
+        for (int32_t i = 0; i < count; i++)
+            ASSERT_EQ(expected[i], result[i]) << "pixel " << i << " alpha " << alpha;
+    }
+
+    uint32_t d[2] = {0x12345678, 0x12345678};
+    const uint32_t s[2] = {0xFF102030, 0x00000000};
+
+    blend_row_scalar(d, s, 2, 255);
+    EXPECT_EQ(0xFF102030U, d[0]); // opaque source replaces the target
+    EXPECT_EQ(0x12345678U, d[1]); // transparent source leaves the target
+}
+
+static void expect_rgba_near(uint32_t expected, uint32_t actual)
+{
+    for (unsigned int i = 0; i < 4; i++)
+        EXPECT_NEAR(channel(expected, i), channel(actual, i), 1)
+                << std::hex << "expected " << expected << " actual " << actual;
+}
+
+TEST(AcrylicCpuKernels, YCbCrToRGBA)
+{
+    CpuCscCoefficients csc;
+
+    // BT.601 limited range
+    compute_csc_coefficients(0.299, 0.114, false, csc);
+
+    EXPECT_EQ(0xFF000000U, ycbcr_to_rgba(csc, 16, 128, 128));
+    EXPECT_EQ(0xFFFFFFFFU, ycbcr_to_rgba(csc, 235, 128, 128));
+    expect_rgba_near(0xFF0000FF, ycbcr_to_rgba(csc, 81, 90, 240));  // red
+    expect_rgba_near(0xFF00FF00, ycbcr_to_rgba(csc, 145, 54, 34));  // green
+    expect_rgba_near(0xFFFF0000, ycbcr_to_rgba(csc, 41, 240, 110)); // blue
+    EXPECT_EQ(0xFF000000U, ycbcr_to_rgba(csc, 0, 128, 128));        // clamped
+    EXPECT_EQ(0xFFFFFFFFU, ycbcr_to_rgba(csc, 255, 128, 128));      // clamped
+
+    // BT.709 full range
+    compute_csc_coefficients(0.2126, 0.0722, true, csc);
+
+    EXPECT_EQ(0xFF000000U, ycbcr_to_rgba(csc, 0, 128, 128));
+    EXPECT_EQ(0xFFFFFFFFU, ycbcr_to_rgba(csc, 255, 128, 128));
+    expect_rgba_near(0xFF0000FF, ycbcr_to_rgba(csc, 54, 99, 255));  // red
+    expect_rgba_near(0xFF00FF00, ycbcr_to_rgba(csc, 182, 30, 12));  // green
+    expect_rgba_near(0xFFFF0000, ycbcr_to_rgba(csc, 18, 255, 116)); // blue
+}
+
+struct SourcePixel {
+    int32_t x;
+    int32_t y;
+};
+
+static SourcePixel map_pixel(const CpuSourceMapping &map, int32_t u, int32_t v)
+{
+    return {static_cast<int32_t>((map.sx + map.sx_du * u + map.sx_dv * v) >> 16),
+            static_cast<int32_t>((map.sy + map.sy_du * u + map.sy_dv * v) >> 16)};
+}
+
+TEST(AcrylicCpuKernels, SourceMapping)
+{
+    const int32_t w = 5;
+    const int32_t h = 3;
+    const hw2d_coord_t crop = {w, h};
+    const hw2d_coord_t window = {w, h};
+    const hw2d_coord_t rotated = {h, w};
+    const struct {
+        uint32_t transform;
+        const hw2d_coord_t &window;
+        SourcePixel (*expected)(int32_t u, int32_t v);
+    } cases[] = {
+        {0, window, [] (int32_t u, int32_t v) -> SourcePixel { return {u, v}; }},
+        {HAL_TRANSFORM_FLIP_H, window, [] (int32_t u, int32_t v) -> SourcePixel { return {w - 1 - u, v}; }},
+        {HAL_TRANSFORM_FLIP_V, window, [] (int32_t u, int32_t v) -> SourcePixel { return {u, h - 1 - v}; }},
+        {HAL_TRANSFORM_ROT_180, window,
+         [] (int32_t u, int32_t v) -> SourcePixel { return {w - 1 - u, h - 1 - v}; }},
+        {HAL_TRANSFORM_ROT_90, rotated, [] (int32_t u, int32_t v) -> SourcePixel { return {v, h - 1 - u}; }},
+        {HAL_TRANSFORM_ROT_270, rotated, [] (int32_t u, int32_t v) -> SourcePixel { return {w - 1 - v, u}; }},
+        {HAL_TRANSFORM_ROT_90 | HAL_TRANSFORM_FLIP_H, rotated,
+         [] (int32_t u, int32_t v) -> SourcePixel { return {w - 1 - v, h - 1 - u}; }},
+        {HAL_TRANSFORM_ROT_90 | HAL_TRANSFORM_FLIP_V, rotated,
+         [] (int32_t u, int32_t v) -> SourcePixel { return {v, u}; }},
+    };
+
+    for (auto &c : cases) {
+        CpuSourceMapping map;
+
+        get_source_mapping(c.transform, crop, c.window, map);
+        EXPECT_FALSE(map.scaled) << "transform " << c.transform;
+
+        for (int32_t v = 0; v < c.window.vert; v++) {
+            for (int32_t u = 0; u < c.window.hori; u++) {
+                SourcePixel actual = map_pixel(map, u, v);
+                SourcePixel expected = c.expected(u, v);
+
+                EXPECT_EQ(expected.x, actual.x) << "transform " << c.transform << " (" << u << ", " << v << ")";
+                EXPECT_EQ(expected.y, actual.y) << "transform " << c.transform << " (" << u << ", " << v << ")";
+            }
+        }
+    }
+}
+
+TEST(AcrylicCpuKernels, SourceMappingScaled)
+{
+    CpuSourceMapping map;
+
+    // downscaling by 2 samples at the center of each 2x2 block
+    get_source_mapping(0, {8, 4}, {4, 2}, map);
+    EXPECT_TRUE(map.scaled);
+    EXPECT_EQ(2 << 16, map.sx_du);
+    EXPECT_EQ(2 << 16, map.sy_dv);
+    EXPECT_EQ(1 << 16, map.sx);
+    EXPECT_EQ(1 << 16, map.sy);
+
+    // rotation swaps the dimensions without scaling
+    get_source_mapping(HAL_TRANSFORM_ROT_90, {8, 4}, {4, 8}, map);
+    EXPECT_FALSE(map.scaled);
+    get_source_mapping(HAL_TRANSFORM_ROT_90, {8, 4}, {8, 4}, map);
+    EXPECT_TRUE(map.scaled);
+}
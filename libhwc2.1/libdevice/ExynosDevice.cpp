@@ -447,6 +447,7 @@ void ExynosDevice::dump(String8 &result) {
 
     result.appendFormat("\n");
     mResourceManager->dump(result);
+    if (mDeviceInterface) mDeviceInterface->dump(result);
 
     result.appendFormat("special plane num: %d:\n", getSpecialPlaneNum());
     for (uint32_t index = 0; index < getSpecialPlaneNum(); index++) {
@@ -146,6 +146,9 @@ enum {
     GEOMETRY_ERROR_CASE                       = 1ULL << 63,
 };
 
+/* Bits that are only set by per-layer setters */
+constexpr uint64_t GEOMETRY_LAYER_CHANGED_MASK = GEOMETRY_DISPLAY_LAYER_ADDED - 1;
+
 class ExynosDisplay;
 class ExynosResourceManager;
 
@@ -1196,6 +1196,7 @@ int32_t ExynosDisplay::destroyLayer(hwc2_layer_t outLayer) {
     } else {
         setGeometryChanged(GEOMETRY_DISPLAY_LAYER_REMOVED);
     }
+    mLayerRegistry.erase(layer);
 
     mDisplayInterface->destroyLayer(layer);
     layer->resetAssignedResource();
@@ -1227,21 +1228,13 @@ void ExynosDisplay::destroyLayers() {
         it = mIgnoreLayers.erase(it);
         delete layer;
     }
+    mLayerRegistry.clear();
 }
 
 ExynosLayer *ExynosDisplay::checkLayer(hwc2_layer_t addr) {
     ExynosLayer *temp = (ExynosLayer *)addr;
-    if (!mLayers.isEmpty()) {
-        for (size_t i = 0; i < mLayers.size(); i++) {
-            if (mLayers[i] == temp)
-                return mLayers[i];
-        }
-    }
-
-    if (mIgnoreLayers.size()) {
-        auto it = std::find(mIgnoreLayers.begin(), mIgnoreLayers.end(), temp);
-        return (it == mIgnoreLayers.end()) ? NULL : *it;
-    }
+    if (mLayerRegistry.find(temp) != mLayerRegistry.end())
+        return temp;
 
     ALOGE("HWC2 : %s : %d, wrong layer request!", __func__, __LINE__);
     return NULL;
@@ -2707,6 +2700,8 @@ int ExynosDisplay::deliverWinConfigData() {
     struct timeval tv_s, tv_e;
     long timediff;
 
+    traceFrameStage(FRAME_STAGE_DELIVER_WIN_CONFIG);
+
     ret = validateWinConfigData();
     if (ret != NO_ERROR) {
         errString.appendFormat("Invalid WIN_CONFIG\n");
@@ -2736,6 +2731,7 @@ int ExynosDisplay::deliverWinConfigData() {
         if (mUsePowerHints) {
             mRetireFenceWaitTime = systemTime();
         }
+        traceFrameStage(FRAME_STAGE_RETIRE_FENCE_WAIT);
         if (fence_valid(mLastRetireFence)) {
             ATRACE_NAME("waitLastRetireFence");
             if (sync_wait(mLastRetireFence, waitTime) < 0) {
@@ -2756,6 +2752,16 @@ int ExynosDisplay::deliverWinConfigData() {
         if (mUsePowerHints) {
             mRetireFenceAcquireTime = systemTime();
         }
+        traceFrameStage(FRAME_STAGE_RETIRE_FENCE_ACQUIRED);
+        if ((mLastRetireFenceFrame >= 0) && fence_valid(mLastRetireFence)) {
+            /* mLastRetireFence belongs to the frame that presented it */
+            FrameTrace& trace = mFrameTraces[mLastRetireFenceFrame % kFrameTraceSize];
+            nsecs_t signalTime = getSignalTime(mLastRetireFence);
+            if ((trace.frameNumber == static_cast<uint64_t>(mLastRetireFenceFrame)) &&
+                (signalTime != SIGNAL_TIME_PENDING) && (signalTime != SIGNAL_TIME_INVALID)) {
+                trace.stamps[FRAME_STAGE_RETIRE_FENCE_SIGNALED] = signalTime;
+            }
+        }
         for (size_t i = 0; i < mDpuData.configs.size(); i++) {
             setFenceInfo(mDpuData.configs[i].acq_fence, this, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP,
                          HwcFenceDirection::TO);
@@ -2767,6 +2773,7 @@ int ExynosDisplay::deliverWinConfigData() {
         } else {
             mLastDpuData = mDpuData;
         }
+        traceFrameStage(FRAME_STAGE_COMMIT_DONE);
 
         for (size_t i = 0; i < mDpuData.configs.size(); i++) {
             setFenceInfo(mDpuData.configs[i].rel_fence, this, FENCE_TYPE_SRC_RELEASE, FENCE_IP_DPP,
@@ -3025,6 +3032,7 @@ int32_t ExynosDisplay::createLayer(hwc2_layer_t* outLayer) {
 
     /* TODO : Sort sequence should be added to somewhere */
     mLayers.add((ExynosLayer*)layer);
+    mLayerRegistry.insert(layer);
 
     /* TODO : Set z-order to max, check outLayer address? */
     layer->setLayerZOrder(1000);
@@ -3539,6 +3547,7 @@ void ExynosDisplay::dumpAllBuffers() {
     String8 displayDump;
     dumpLocked(displayDump);
     infoFile << displayDump << std::endl;
+    writeFrameTraces(String8::format("%s/%03d-frame-trace.bin", kBufferDumpPath, mBufferDumpNum));
 
     // dump buffer contents & infos
     std::vector<String8> allLayerKeys;
@@ -3639,6 +3648,7 @@ void ExynosDisplay::dumpAllBuffers() {
 int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
     DISPLAY_ATRACE_CALL();
     gettimeofday(&updateTimeInfo.lastPresentTime, NULL);
+    const nsecs_t presentEntryTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
     const bool mixedComposition = isMixedComposition();
     // store this once here for the whole frame so it's consistent
@@ -3732,6 +3742,12 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
 
     tryUpdateBtsFromOperationRate(true);
 
+    if (!mFrameTraceOpen) {
+        /* validate was skipped */
+        beginFrameTrace();
+    }
+    traceFrameStage(FRAME_STAGE_PRESENT_START, presentEntryTime);
+
     if (mRenderingState != RENDERING_STATE_ACCEPTED_CHANGE) {
         /*
          * presentDisplay() can be called before validateDisplay()
@@ -3912,6 +3928,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
     mLastRetireFence = fence_close(mLastRetireFence, this, FENCE_TYPE_RETIRE, FENCE_IP_DPP);
     mLastRetireFence = hwc_dup((*outRetireFence), this, FENCE_TYPE_RETIRE, FENCE_IP_DPP, true);
     setFenceName(mLastRetireFence, FENCE_RETIRE);
+    mLastRetireFenceFrame = mFrameTraceOpen ? static_cast<int64_t>(mFrameTraceCurrent) : -1;
 
     increaseMPPDstBufIndex();
 
@@ -3983,8 +4000,12 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
 
     tryUpdateBtsFromOperationRate(false);
 
+    traceFrameStage(FRAME_STAGE_PRESENT_DONE);
+    endFrameTrace();
+
     return ret;
 err:
+    endFrameTrace();
     printDebugInfos(errString);
     closeFences();
     *outRetireFence = -1;
@@ -4904,6 +4925,8 @@ int32_t ExynosDisplay::validateDisplay(
     mUpdateEventCnt++;
     mUpdateCallCnt++;
     mLastUpdateTimeStamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    beginFrameTrace();
+    traceFrameStage(FRAME_STAGE_VALIDATE_START, static_cast<nsecs_t>(mLastUpdateTimeStamp));
 
     if (usePowerHintSession()) {
         mValidateStartTime = mLastUpdateTimeStamp;
@@ -4944,6 +4967,7 @@ int32_t ExynosDisplay::validateDisplay(
         printDebugInfos(errString);
         mDisplayInterface->setForcePanic();
     }
+    traceFrameStage(FRAME_STAGE_ASSIGN_RESOURCE_DONE);
 
     if ((ret = skipStaticLayers(mClientCompositionInfo)) != NO_ERROR) {
         validateError = true;
@@ -5117,6 +5141,10 @@ void ExynosDisplay::dumpLocked(String8& result) {
     mExynosCompositionInfo.dump(result);
 
     result.appendFormat("PanelGammaSource (%d)\n\n", GetCurrentPanelGammaSource());
+    dumpFrameTraces(result);
+    if (mDisplayInterface) {
+        mDisplayInterface->dump(result);
+    }
 
     {
         Mutex::Autolock lock(mDRMutex);
@@ -5147,6 +5175,82 @@ void ExynosDisplay::dumpLocked(String8& result) {
     }
 }
 
+void ExynosDisplay::beginFrameTrace() {
+    mFrameTraceCurrent = mFrameTraceCount++;
+    FrameTrace& trace = mFrameTraces[mFrameTraceCurrent % kFrameTraceSize];
+    trace.frameNumber = mFrameTraceCurrent;
+    std::fill(std::begin(trace.stamps), std::end(trace.stamps), 0);
+    mFrameTraceOpen = true;
+}
+
+void ExynosDisplay::traceFrameStage(frame_stage_t stage, nsecs_t time) {
+    if (!mFrameTraceOpen) return;
+    mFrameTraces[mFrameTraceCurrent % kFrameTraceSize].stamps[stage] = time;
+}
+
+void ExynosDisplay::endFrameTrace() {
+    mFrameTraceOpen = false;
+}
+
+void ExynosDisplay::dumpFrameTraces(String8& result) {
+    static const char* const kStageNames[FRAME_STAGE_MAX] = {
+            "validate", "assign", "present", "deliver", "fenceWait",
+            "fenceAcq", "commit",  "done",    "retire",
+    };
+    uint64_t count = std::min<uint64_t>(mFrameTraceCount, kFrameTraceDumpCount);
+
+    result.appendFormat("Frame stages (us from first stage) of last %" PRIu64 " frames\n", count);
+    result.appendFormat("\t%8s", "frame");
+    for (const char* name : kStageNames) {
+        result.appendFormat(" %9s", name);
+    }
+    result.appendFormat("\n");
+    for (uint64_t i = mFrameTraceCount - count; i < mFrameTraceCount; i++) {
+        const FrameTrace& trace = mFrameTraces[i % kFrameTraceSize];
+        nsecs_t base = 0;
+        for (nsecs_t stamp : trace.stamps) {
+            if (stamp != 0) {
+                base = stamp;
+                break;
+            }
+        }
+        result.appendFormat("\t%8" PRIu64, trace.frameNumber);
+        for (nsecs_t stamp : trace.stamps) {
+            if (stamp == 0)
+                result.appendFormat(" %9s", "-");
+            else
+                result.appendFormat(" %9" PRId64, ns2us(stamp - base));
+        }
+        result.appendFormat("\n");
+    }
+    result.appendFormat("\n");
+}
+
+/*
+ * Binary layout: "HWCFTRC\0", uint32_t version, uint32_t stage count,
+ * uint32_t frame count, then FrameTrace records from oldest to newest.
+ */
+void ExynosDisplay::writeFrameTraces(const String8& path) {
+    static const char kMagic[8] = "HWCFTRC";
+    const uint32_t version = 1;
+    const uint32_t stages = FRAME_STAGE_MAX;
+    const uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(mFrameTraceCount, kFrameTraceSize));
+
+    std::ofstream traceFile(path.c_str(), std::ios::binary);
+    if (!traceFile) {
+        DISPLAY_LOGE("%s: failed to open file %s", __func__, path.c_str());
+        return;
+    }
+    traceFile.write(kMagic, sizeof(kMagic));
+    traceFile.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    traceFile.write(reinterpret_cast<const char*>(&stages), sizeof(stages));
+    traceFile.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (uint64_t i = mFrameTraceCount - count; i < mFrameTraceCount; i++) {
+        traceFile.write(reinterpret_cast<const char*>(&mFrameTraces[i % kFrameTraceSize]),
+                        sizeof(FrameTrace));
+    }
+}
+
 void ExynosDisplay::dumpConfig(String8 &result, const exynos_win_config_data &c)
 {
     result.appendFormat("\tstate = %u\n", c.state);
@@ -6279,6 +6383,8 @@ void ExynosDisplay::initDisplayInterface(uint32_t __unused interfaceType)
 int32_t ExynosDisplay::uncacheLayerBuffers(ExynosLayer* layer,
                                            const std::vector<buffer_handle_t>& buffers,
                                            std::vector<buffer_handle_t>& outClearableBuffers) {
+    layer->uncacheMetaMappings(buffers);
+
     if (mPowerModeState.has_value() && mPowerModeState.value() == HWC2_POWER_MODE_OFF) {
         for (auto buffer : buffers) {
             if (layer->mLayerBuffer == buffer) {
@@ -6444,9 +6550,27 @@ nsecs_t ExynosDisplay::getPredictedPresentTime(nsecs_t startTime) {
         ALOGV("Could not predict expected present time, fall back on target of one vsync");
         expectedPresentTime = startTime + mVsyncPeriod;
     }
+
+    // Snap the estimate to the nearest vsync of the fitted timeline
+    std::vector<nsecs_t> vsyncs;
+    if (getPredictedVsyncs(expectedPresentTime, 2, vsyncs) == NO_ERROR) {
+        nsecs_t previousVsync = vsyncs[0] - (vsyncs[1] - vsyncs[0]);
+        if ((expectedPresentTime - previousVsync < vsyncs[0] - expectedPresentTime) &&
+            (previousVsync >= startTime)) {
+            expectedPresentTime = previousVsync;
+        } else {
+            expectedPresentTime = vsyncs[0];
+        }
+    }
     return expectedPresentTime;
 }
 
+int32_t ExynosDisplay::getPredictedVsyncs(nsecs_t timeNs, size_t count,
+                                          std::vector<nsecs_t>& outVsyncs) {
+    if (mDisplayInterface == nullptr) return HWC2_ERROR_UNSUPPORTED;
+    return mDisplayInterface->getPredictedVsyncs(timeNs, count, outVsyncs);
+}
+
 nsecs_t ExynosDisplay::getSignalTime(int32_t fd) const {
     if (fd == -1) {
         return SIGNAL_TIME_INVALID;
@@ -6475,7 +6599,48 @@ nsecs_t ExynosDisplay::getSignalTime(int32_t fd) const {
     return nsecs_t(timestamp);
 }
 
+/*
+ * Composition of the layers as last assigned. During validation this is still
+ * the previous frame's, which is usually what the new frame ends up with too.
+ */
+ExynosDisplay::PredictionKey ExynosDisplay::getPredictionKey(bool validated,
+                                                             bool beforeReleaseFence) {
+    uint32_t clientLayers = 0, m2mLayers = 0, scaledLayers = 0, afbcLayers = 0;
+
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        ExynosLayer* layer = mLayers[i];
+        if (layer->mExynosCompositionType == HWC2_COMPOSITION_CLIENT)
+            clientLayers++;
+        else if ((layer->mExynosCompositionType == HWC2_COMPOSITION_EXYNOS) ||
+                 (layer->mM2mMPP != nullptr))
+            m2mLayers++;
+
+        const hwc_frect_t& crop = layer->mPreprocessedInfo.sourceCrop;
+        const hwc_rect_t& frame = layer->mPreprocessedInfo.displayFrame;
+        float srcW = crop.right - crop.left;
+        float srcH = crop.bottom - crop.top;
+        if (layer->mTransform & HAL_TRANSFORM_ROT_90) std::swap(srcW, srcH);
+        if ((srcW != float(frame.right - frame.left)) || (srcH != float(frame.bottom - frame.top)))
+            scaledLayers++;
+
+        if (layer->mCompressionInfo.type == COMP_TYPE_AFBC) afbcLayers++;
+    }
+
+    return PredictionKey(mLayers.size(), validated, beforeReleaseFence, clientLayers, m2mLayers,
+                         scaledLayers, afbcLayers);
+}
+
 std::optional<nsecs_t> ExynosDisplay::getPredictedDuration(bool duringValidation) {
+    auto beforeFence = mRollingPercentiles.find(getPredictionKey(duringValidation, true));
+    auto afterFence = mRollingPercentiles.find(getPredictionKey(duringValidation, false));
+    if ((beforeFence != mRollingPercentiles.end()) && (afterFence != mRollingPercentiles.end()) &&
+        (beforeFence->second.samples.elems >= kPredictionMinSamples) &&
+        (afterFence->second.samples.elems >= kPredictionMinSamples)) {
+        return std::make_optional(beforeFence->second.samples.percentile(kPredictionPercentile) +
+                                  afterFence->second.samples.percentile(kPredictionPercentile));
+    }
+
+    /* not enough history for this composition yet, use the layer count average */
     AveragesKey beforeFenceKey(mLayers.size(), duringValidation, true);
     AveragesKey afterFenceKey(mLayers.size(), duringValidation, false);
     if (mRollingAverages.count(beforeFenceKey) == 0 || mRollingAverages.count(afterFenceKey) == 0) {
@@ -6497,6 +6662,28 @@ void ExynosDisplay::updateAverages(nsecs_t endTime) {
             beforeFenceTime);
     mRollingAverages[AveragesKey(mLayers.size(), mValidationDuration.has_value(), false)].insert(
             afterFenceTime);
+
+    PredictionKey beforeFenceKey = getPredictionKey(mValidationDuration.has_value(), true);
+    PredictionKey afterFenceKey = getPredictionKey(mValidationDuration.has_value(), false);
+    insertPrediction(beforeFenceKey, beforeFenceTime);
+    insertPrediction(afterFenceKey, afterFenceTime);
+}
+
+void ExynosDisplay::insertPrediction(PredictionKey key, nsecs_t duration) {
+    auto it = mRollingPercentiles.find(key);
+    if (it == mRollingPercentiles.end()) {
+        if (mRollingPercentiles.size() >= kPredictionMaxKeys) {
+            /* forget the composition that has not been seen for the longest */
+            auto lru = std::min_element(mRollingPercentiles.begin(), mRollingPercentiles.end(),
+                                        [](const auto& a, const auto& b) {
+                                            return a.second.lastUsed < b.second.lastUsed;
+                                        });
+            mRollingPercentiles.erase(lru);
+        }
+        it = mRollingPercentiles.emplace(key, PredictionHistory()).first;
+    }
+    it->second.lastUsed = ++mPredictionUseCount;
+    it->second.samples.insert(duration);
 }
 
 int32_t ExynosDisplay::getRCDLayerSupport(bool &outSupport) const {
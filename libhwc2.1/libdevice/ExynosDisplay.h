@@ -24,9 +24,11 @@
 #include <utils/KeyedVector.h>
 #include <utils/Vector.h>
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <set>
+#include <unordered_set>
 
 #include "DeconHeader.h"
 #include "ExynosDisplayInterface.h"
@@ -485,6 +487,8 @@ class ExynosDisplay {
          */
         ExynosSortedLayer mLayers;
         std::vector<ExynosLayer*> mIgnoreLayers;
+        /* All layers created on this display, both in mLayers and mIgnoreLayers */
+        std::unordered_set<ExynosLayer*> mLayerRegistry;
 
         ExynosResourceManager *mResourceManager;
 
@@ -1250,6 +1254,7 @@ class ExynosDisplay {
 
         virtual void dump(String8& result);
         void dumpLocked(String8& result) REQUIRES(mDisplayMutex);
+        void dumpFrameTraces(String8& result) REQUIRES(mDisplayMutex);
         void dumpAllBuffers() REQUIRES(mDisplayMutex);
 
         virtual int32_t startPostProcessing();
@@ -1424,6 +1429,8 @@ class ExynosDisplay {
         void setPeakRefreshRate(float rr) { mPeakRefreshRate = rr; }
         uint32_t getPeakRefreshRate();
         VsyncPeriodNanos getVsyncPeriod(const int32_t config);
+        /* Vsync timeline fitted to the hardware vblanks of the panel */
+        int32_t getPredictedVsyncs(nsecs_t timeNs, size_t count, std::vector<nsecs_t>& outVsyncs);
         uint32_t getRefreshRate(const int32_t config);
         uint32_t getConfigId(const int32_t refreshRate, const int32_t width, const int32_t height);
 
@@ -1622,10 +1629,80 @@ class ExynosDisplay {
             operator uint32_t() const { return value; }
         };
 
+        /*
+         * Finer grained key for duration prediction: besides the layer count it
+         * includes how the layers were composed, since a G2D or client
+         * composed frame costs much more than an all-OTF one with the same
+         * number of layers.
+         */
+        struct PredictionKey {
+            uint64_t value;
+            PredictionKey(size_t layers, bool validated, bool beforeReleaseFence,
+                          uint32_t clientLayers, uint32_t m2mLayers, uint32_t scaledLayers,
+                          uint32_t afbcLayers)
+                  : value((static_cast<uint64_t>(std::min<size_t>(layers, UINT16_MAX))) |
+                          (static_cast<uint64_t>(validated) << 16) |
+                          (static_cast<uint64_t>(beforeReleaseFence) << 17) |
+                          (static_cast<uint64_t>(std::min(clientLayers, 0xffu)) << 24) |
+                          (static_cast<uint64_t>(std::min(m2mLayers, 0xffu)) << 32) |
+                          (static_cast<uint64_t>(std::min(scaledLayers, 0xffu)) << 40) |
+                          (static_cast<uint64_t>(std::min(afbcLayers, 0xffu)) << 48)) {}
+            operator uint64_t() const { return value; }
+        };
+
         static const constexpr int kAveragesBufferSize = 3;
+        static const constexpr int kPredictionBufferSize = 32;
+        /* samples needed before a PredictionKey is trusted over mRollingAverages */
+        static const constexpr size_t kPredictionMinSamples = 8;
+        /* the predicted duration targets the tail rather than the mean */
+        static const constexpr uint32_t kPredictionPercentile = 90;
+        static const constexpr size_t kPredictionMaxKeys = 64;
         static const constexpr nsecs_t SIGNAL_TIME_PENDING = INT64_MAX;
         static const constexpr nsecs_t SIGNAL_TIME_INVALID = -1;
         std::unordered_map<uint32_t, RollingAverage<kAveragesBufferSize>> mRollingAverages;
+        struct PredictionHistory {
+            RollingPercentile<kPredictionBufferSize> samples;
+            /* value of mPredictionUseCount when the key was last updated */
+            uint64_t lastUsed = 0;
+        };
+        std::unordered_map<uint64_t, PredictionHistory> mRollingPercentiles;
+        uint64_t mPredictionUseCount = 0;
+
+        /* Stages of a frame recorded in mFrameTraces, in the order they happen */
+        enum frame_stage_t : uint32_t {
+            FRAME_STAGE_VALIDATE_START = 0,
+            FRAME_STAGE_ASSIGN_RESOURCE_DONE,
+            FRAME_STAGE_PRESENT_START,
+            FRAME_STAGE_DELIVER_WIN_CONFIG,
+            FRAME_STAGE_RETIRE_FENCE_WAIT,
+            FRAME_STAGE_RETIRE_FENCE_ACQUIRED,
+            FRAME_STAGE_COMMIT_DONE,
+            FRAME_STAGE_PRESENT_DONE,
+            FRAME_STAGE_RETIRE_FENCE_SIGNALED,
+            FRAME_STAGE_MAX,
+        };
+        struct FrameTrace {
+            uint64_t frameNumber;
+            /* monotonic time of each stage, 0 if the frame didn't reach it */
+            nsecs_t stamps[FRAME_STAGE_MAX];
+        };
+        static const constexpr uint32_t kFrameTraceSize = 128;
+        static const constexpr uint32_t kFrameTraceDumpCount = 16;
+        /*
+         * Only touched with mDisplayMutex held, which validate, present and dump
+         * already hold, so recording a stage is a plain store into the ring.
+         */
+        std::array<FrameTrace, kFrameTraceSize> mFrameTraces{};
+        uint64_t mFrameTraceCount = 0;
+        /* frame number of the trace being recorded */
+        uint64_t mFrameTraceCurrent = 0;
+        /* frame number of the trace that mLastRetireFence was presented by, -1 if none */
+        int64_t mLastRetireFenceFrame = -1;
+        bool mFrameTraceOpen = false;
+        void beginFrameTrace();
+        void traceFrameStage(frame_stage_t stage, nsecs_t time = systemTime(SYSTEM_TIME_MONOTONIC));
+        void endFrameTrace();
+        void writeFrameTraces(const String8& path);
         // mPowerHalHint should be declared only after mDisplayId and mDisplayTraceName have been
         // declared since mDisplayId and mDisplayTraceName are needed as the parameter of
         // PowerHalHintWorker's constructor
@@ -1652,6 +1729,8 @@ class ExynosDisplay {
         nsecs_t getPredictedPresentTime(nsecs_t startTime);
         nsecs_t getSignalTime(int32_t fd) const;
         void updateAverages(nsecs_t endTime);
+        PredictionKey getPredictionKey(bool validated, bool beforeReleaseFence);
+        void insertPrediction(PredictionKey key, nsecs_t duration);
         std::optional<nsecs_t> getPredictedDuration(bool duringValidation);
         atomic_bool mDebugRCDLayerEnabled = true;
 
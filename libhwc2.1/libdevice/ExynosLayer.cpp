@@ -85,6 +85,8 @@ ExynosLayer::ExynosLayer(ExynosDisplay* display)
 }
 
 ExynosLayer::~ExynosLayer() {
+    releaseMetaMappings();
+
     if (mMetaParcel != NULL) {
         munmap(mMetaParcel, sizeof(ExynosVideoMeta));
         mMetaParcel = NULL;
@@ -210,25 +212,29 @@ int32_t ExynosLayer::doPreProcess()
 
         if (priv_fd >= 0) {
 
-            metaData = (ExynosVideoMeta*)mmap(0, sizeof(ExynosVideoMeta), PROT_READ|PROT_WRITE, MAP_SHARED, priv_fd, 0);
+            metaData = getMetaMapping(gmeta.unique_id, priv_fd);
 
-            if (metaData == NULL) {
-                HWC_LOGE(mDisplay, "Layer's metadata is NULL!!");
-            } else if (metaData == MAP_FAILED) {
-                HWC_LOGE(mDisplay, "Layer's metadata map failed!!");
-            } else {
+            if (metaData != NULL) {
                 mBufferHasMetaParcel = true;
                 if ((metaData->eType & VIDEO_INFO_TYPE_HDR_STATIC) ||
                         (metaData->eType & VIDEO_INFO_TYPE_HDR_DYNAMIC)) {
                     if (allocMetaParcel() == NO_ERROR) {
+                        /* HDR info usually stays the same for the whole stream */
+                        bool typeChanged = (mMetaParcel->eType != metaData->eType);
                         mMetaParcel->eType = metaData->eType;
-                        if (metaData->eType & VIDEO_INFO_TYPE_HDR_STATIC) {
+                        if ((metaData->eType & VIDEO_INFO_TYPE_HDR_STATIC) &&
+                            (typeChanged ||
+                             memcmp(&mMetaParcel->sHdrStaticInfo, &metaData->sHdrStaticInfo,
+                                    sizeof(mMetaParcel->sHdrStaticInfo)))) {
                             mMetaParcel->sHdrStaticInfo = metaData->sHdrStaticInfo;
                             HDEBUGLOGD(eDebugLayer, "HWC2: Static metadata min(%d), max(%d)",
                                     mMetaParcel->sHdrStaticInfo.sType1.mMinDisplayLuminance,
                                     mMetaParcel->sHdrStaticInfo.sType1.mMaxDisplayLuminance);
                         }
-                        if (metaData->eType & VIDEO_INFO_TYPE_HDR_DYNAMIC) {
+                        if ((metaData->eType & VIDEO_INFO_TYPE_HDR_DYNAMIC) &&
+                            (typeChanged ||
+                             memcmp(&mMetaParcel->sHdrDynamicInfo, &metaData->sHdrDynamicInfo,
+                                    sizeof(mMetaParcel->sHdrDynamicInfo)))) {
                             /* Reserved field for dynamic meta data */
                             /* Currently It's not be used not only HWC but also OMX */
                             mMetaParcel->sHdrDynamicInfo = metaData->sHdrDynamicInfo;
@@ -254,7 +260,6 @@ int32_t ExynosLayer::doPreProcess()
                     mPreprocessedInfo.mUsePrivateFormat = true;
                     mPreprocessedInfo.mPrivateFormat = metaData->nPixelFormat;
                 }
-                munmap(metaData, sizeof(ExynosVideoMeta));
             }
         }
         mPreprocessedInfo.preProcessed = true;
@@ -1228,6 +1233,58 @@ int ExynosLayer::allocMetaParcel()
     return NO_ERROR;
 }
 
+ExynosVideoMeta* ExynosLayer::getMetaMapping(uint64_t bufferId, int fd)
+{
+    for (auto it = mMetaMappings.begin(); it != mMetaMappings.end(); it++) {
+        if (it->bufferId == bufferId) {
+            mMetaMappings.splice(mMetaMappings.begin(), mMetaMappings, it);
+            return it->meta;
+        }
+    }
+
+    ExynosVideoMeta *meta = (ExynosVideoMeta*)mmap(0, sizeof(ExynosVideoMeta),
+            PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (meta == NULL) {
+        HWC_LOGE(mDisplay, "Layer's metadata is NULL!!");
+        return NULL;
+    } else if (meta == MAP_FAILED) {
+        HWC_LOGE(mDisplay, "Layer's metadata map failed!!");
+        return NULL;
+    }
+
+    /* A mapping keeps its buffer alive, so only a few are kept around */
+    if (mMetaMappings.size() >= kMetaMappingCacheSize) {
+        munmap(mMetaMappings.back().meta, sizeof(ExynosVideoMeta));
+        mMetaMappings.pop_back();
+    }
+    mMetaMappings.push_front({bufferId, meta});
+
+    return meta;
+}
+
+void ExynosLayer::uncacheMetaMappings(const std::vector<buffer_handle_t>& buffers)
+{
+    for (auto buffer : buffers) {
+        if (buffer == NULL)
+            continue;
+        VendorGraphicBufferMeta gmeta(buffer);
+        for (auto it = mMetaMappings.begin(); it != mMetaMappings.end(); it++) {
+            if (it->bufferId == gmeta.unique_id) {
+                munmap(it->meta, sizeof(ExynosVideoMeta));
+                mMetaMappings.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+void ExynosLayer::releaseMetaMappings()
+{
+    for (auto &mapping : mMetaMappings)
+        munmap(mapping.meta, sizeof(ExynosVideoMeta));
+    mMetaMappings.clear();
+}
+
 bool ExynosLayer::isDimLayer()
 {
     if (mLayerFlag & EXYNOS_HWC_DIM_LAYER)
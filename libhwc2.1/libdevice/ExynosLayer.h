@@ -24,6 +24,7 @@
 #include <utils/Timers.h>
 
 #include <array>
+#include <list>
 #include <unordered_map>
 
 #include "ExynosDisplay.h"
@@ -510,10 +511,25 @@ class ExynosLayer : public ExynosMPPSource {
         void clearGeometryChanged() {mGeometryChanged = 0;};
         bool isDimLayer();
         const ExynosVideoMeta* getMetaParcel() { return mMetaParcel; };
+        /* Unmaps the video metadata of buffers the client has released */
+        void uncacheMetaMappings(const std::vector<buffer_handle_t>& buffers);
 
     private:
         ExynosVideoMeta *mMetaParcel;
         int allocMetaParcel();
+
+        /**
+         * Video metadata of the most recently used buffers, mapped once per
+         * buffer instead of once per frame. Most recently used first.
+         */
+        struct MetaMapping {
+            uint64_t bufferId;
+            ExynosVideoMeta *meta;
+        };
+        static constexpr size_t kMetaMappingCacheSize = 8;
+        std::list<MetaMapping> mMetaMappings;
+        ExynosVideoMeta* getMetaMapping(uint64_t bufferId, int fd);
+        void releaseMetaMappings();
 };
 
 #endif //_EXYNOSLAYER_H
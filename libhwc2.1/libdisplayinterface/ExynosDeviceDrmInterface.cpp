@@ -392,3 +392,7 @@ int32_t ExynosDeviceDrmInterface::registerSysfsEventHandler(
 int32_t ExynosDeviceDrmInterface::unregisterSysfsEventHandler(int sysfsFd) {
     return mDrmDevice->event_listener()->UnRegisterSysfsHandler(sysfsFd);
 }
+
+void ExynosDeviceDrmInterface::dump(String8 &result) {
+    mDrmDevice->event_listener()->DumpDispatchStats(result);
+}
@@ -35,6 +35,7 @@ class ExynosDeviceDrmInterface : public ExynosDeviceInterface {
         virtual int32_t registerSysfsEventHandler(
                 std::shared_ptr<DrmSysfsEventHandler> handler) override;
         virtual int32_t unregisterSysfsEventHandler(int sysfsFd) override;
+        virtual void dump(String8 &result) override;
 
     protected:
         class ExynosDrmEventHandler : public DrmEventHandler,
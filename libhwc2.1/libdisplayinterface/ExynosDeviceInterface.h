@@ -98,6 +98,7 @@ class ExynosDeviceInterface {
         virtual int32_t unregisterSysfsEventHandler(int __unused sysfsFd) {
             return android::INVALID_OPERATION;
         }
+        virtual void dump(String8 __unused &result) {}
 
         uint32_t getNumDPPChs() { return mDPUInfo.dpuInfo.dpp_chs.size(); };
         uint32_t getNumSPPChs() { return mDPUInfo.dpuInfo.spp_chs.size(); };
@@ -27,6 +27,7 @@
 
 #include <algorithm>
 #include <numeric>
+#include <string_view>
 
 #include "BrightnessController.h"
 #include "ExynosHWCDebug.h"
@@ -147,9 +148,9 @@ void FramebufferManager::cleanup(const ExynosLayer *layer) {
     ATRACE_CALL();
 
     Mutex::Autolock lock(mMutex);
-    auto clean = [&](std::map<const ExynosLayer *, FBList> &layerBuffs) {
+    auto clean = [&](FBCacheMap &layerBuffs) {
         if (auto it = layerBuffs.find(layer); it != layerBuffs.end()) {
-            mCleanBuffers.splice(mCleanBuffers.end(), std::move(it->second));
+            mCleanBuffers.splice(mCleanBuffers.end(), std::move(it->second.fbList));
             layerBuffs.erase(it);
         }
     };
@@ -157,6 +158,52 @@ void FramebufferManager::cleanup(const ExynosLayer *layer) {
     clean(mCachedSecureLayerBuffers);
 }
 
+uint32_t FramebufferManager::findCachedFbId(const ExynosLayer *layer, const bool isSecureBuffer,
+                                            const Framebuffer::BufferDesc &bufferDesc) {
+    Mutex::Autolock lock(mMutex);
+    markInuseLayerLocked(layer, isSecureBuffer);
+    auto &cachedBuffers =
+            (!isSecureBuffer) ? mCachedLayerBuffers[layer] : mCachedSecureLayerBuffers[layer];
+    const auto it = cachedBuffers.index.find(bufferDesc);
+    if (it == cachedBuffers.index.end()) {
+        mCacheMisses++;
+        return 0;
+    }
+
+    mCacheHits++;
+    cachedBuffers.fbList.splice(cachedBuffers.fbList.begin(), cachedBuffers.fbList, it->second);
+    return (*it->second)->fbId;
+}
+
+uint32_t FramebufferManager::findCachedFbId(const ExynosLayer *layer, const bool isSecureBuffer,
+                                            const Framebuffer::SolidColorDesc &colorDesc) {
+    Mutex::Autolock lock(mMutex);
+    markInuseLayerLocked(layer, isSecureBuffer);
+    auto &cachedBuffers =
+            (!isSecureBuffer) ? mCachedLayerBuffers[layer] : mCachedSecureLayerBuffers[layer];
+    auto &fbList = cachedBuffers.fbList;
+    const auto it = std::find_if(fbList.begin(), fbList.end(), [&colorDesc](auto &buffer) {
+        return buffer->isSolidColor && buffer->colorDesc == colorDesc;
+    });
+    if (it == fbList.end()) {
+        mCacheMisses++;
+        return 0;
+    }
+
+    mCacheHits++;
+    fbList.splice(fbList.begin(), fbList, it);
+    return (*it)->fbId;
+}
+
+void FramebufferManager::evictLeastRecentlyUsedLocked(FBCache &cache) {
+    auto lru = std::prev(cache.fbList.end());
+    if (!(*lru)->isSolidColor) {
+        cache.index.erase((*lru)->bufferDesc);
+    }
+    mCleanBuffers.splice(mCleanBuffers.end(), cache.fbList, lru);
+    mCacheEvictions++;
+}
+
 void FramebufferManager::removeFBsThreadRoutine()
 {
     FBList cleanupBuffers;
@@ -217,9 +264,8 @@ int32_t FramebufferManager::getBuffer(const exynos_win_config_data &config, uint
         }
 
         fbId = findCachedFbId(config.layer, isSecureBuffer,
-                              [bufferDesc = Framebuffer::BufferDesc{config.buffer_id, drmFormat,
-                                                                    config.protection}](
-                                      auto& buffer) { return buffer->bufferDesc == bufferDesc; });
+                              Framebuffer::BufferDesc{config.buffer_id, drmFormat,
+                                                      config.protection});
         if (fbId != 0) {
             return NO_ERROR;
         }
@@ -270,8 +316,7 @@ int32_t FramebufferManager::getBuffer(const exynos_win_config_data &config, uint
         bpp = getBytePerPixelOfPrimaryPlane(HAL_PIXEL_FORMAT_BGRA_8888);
         pitches[0] = config.dst.w * bpp;
         fbId = findCachedFbId(config.layer, isSecureBuffer,
-                              [colorDesc = Framebuffer::SolidColorDesc{bufWidth, bufHeight}](
-                                      auto& buffer) { return buffer->colorDesc == colorDesc; });
+                              Framebuffer::SolidColorDesc{bufWidth, bufHeight});
         if (fbId != 0) {
             return NO_ERROR;
         }
@@ -307,21 +352,23 @@ int32_t FramebufferManager::getBuffer(const exynos_win_config_data &config, uint
                                                      : MAX_CACHED_SECURE_BUFFERS_PER_LAYER;
         markInuseLayerLocked(config.layer, isSecureBuffer);
 
-        if (cachedBuffers.size() > maxCachedBufferSize) {
-            ALOGW("FBManager: cached buffers size %zu exceeds limitation(%zu) while adding fbId %d",
-                  cachedBuffers.size(), maxCachedBufferSize, fbId);
-            mCleanBuffers.splice(mCleanBuffers.end(), cachedBuffers);
+        while (cachedBuffers.fbList.size() >= maxCachedBufferSize) {
+            evictLeastRecentlyUsedLocked(cachedBuffers);
         }
 
         if (config.state == config.WIN_STATE_COLOR) {
-            cachedBuffers.emplace_front(
+            cachedBuffers.fbList.emplace_front(
                     new Framebuffer(mDrmFd, fbId,
                                     Framebuffer::SolidColorDesc{bufWidth, bufHeight}));
         } else {
-            cachedBuffers.emplace_front(
-                    new Framebuffer(mDrmFd, fbId,
-                                    Framebuffer::BufferDesc{config.buffer_id, drmFormat,
-                                                            config.protection}));
+            const Framebuffer::BufferDesc bufferDesc{config.buffer_id, drmFormat,
+                                                     config.protection};
+            if (auto it = cachedBuffers.index.find(bufferDesc); it != cachedBuffers.index.end()) {
+                // the same buffer was added by another caller in the meantime
+                mCleanBuffers.splice(mCleanBuffers.end(), cachedBuffers.fbList, it->second);
+            }
+            cachedBuffers.fbList.emplace_front(new Framebuffer(mDrmFd, fbId, bufferDesc));
+            cachedBuffers.index[bufferDesc] = cachedBuffers.fbList.begin();
         }
     } else {
         ALOGW("FBManager: possible leakage fbId %d was created", fbId);
@@ -355,6 +402,18 @@ void FramebufferManager::releaseAll()
     mCleanBuffers.clear();
 }
 
+void FramebufferManager::dump(String8 &result) {
+    Mutex::Autolock lock(mMutex);
+    size_t cachedBufferNum = 0;
+    for (const auto &[layer, cache] : mCachedLayerBuffers) {
+        cachedBufferNum += cache.fbList.size();
+    }
+    result.appendFormat("FBManager: layers(%zu), secure layers(%zu), cached fbs(%zu), "
+                        "hits(%" PRIu64 "), misses(%" PRIu64 "), evictions(%" PRIu64 ")\n",
+                        mCachedLayerBuffers.size(), mCachedSecureLayerBuffers.size(),
+                        cachedBufferNum, mCacheHits, mCacheMisses, mCacheEvictions);
+}
+
 void FramebufferManager::freeBufHandle(uint32_t handle) {
     if (handle == 0) {
         return;
@@ -382,7 +441,7 @@ void FramebufferManager::markInuseLayerLocked(const ExynosLayer* layer, const bo
 void FramebufferManager::destroyUnusedLayersLocked() {
     auto destroyUnusedLayers =
             [&](const bool &cacheShrinkPending, std::set<const ExynosLayer *> &cachedLayersInuse,
-                std::map<const ExynosLayer *, FBList> &cachedLayerBuffers) -> bool {
+                FBCacheMap &cachedLayerBuffers) -> bool {
         if (!cacheShrinkPending || cachedLayersInuse.size() == cachedLayerBuffers.size()) {
             cachedLayersInuse.clear();
             return false;
@@ -390,7 +449,7 @@ void FramebufferManager::destroyUnusedLayersLocked() {
 
         for (auto layer = cachedLayerBuffers.begin(); layer != cachedLayerBuffers.end();) {
             if (cachedLayersInuse.find(layer->first) == cachedLayersInuse.end()) {
-                mCleanBuffers.splice(mCleanBuffers.end(), std::move(layer->second));
+                mCleanBuffers.splice(mCleanBuffers.end(), std::move(layer->second.fbList));
                 layer = cachedLayerBuffers.erase(layer);
             } else {
                 ++layer;
@@ -415,10 +474,9 @@ void FramebufferManager::destroyUnusedLayersLocked() {
 }
 
 void FramebufferManager::destroyAllSecureBuffersLocked() {
-    for (auto& [layer, bufferList] : mCachedSecureLayerBuffers) {
-        if (bufferList.size()) {
-            mCleanBuffers.splice(mCleanBuffers.end(), bufferList, bufferList.begin(),
-                                 bufferList.end());
+    for (auto& [layer, cache] : mCachedSecureLayerBuffers) {
+        if (cache.fbList.size()) {
+            mCleanBuffers.splice(mCleanBuffers.end(), cache.fbList);
         }
     }
     mCachedSecureLayerBuffers.clear();
@@ -452,20 +510,19 @@ int32_t FramebufferManager::uncacheLayerBuffers(const ExynosLayer* layer,
     bool needCleanup = false;
     {
         Mutex::Autolock lock(mMutex);
-        auto destroyCachedBuffersLocked =
-                [&](std::map<const ExynosLayer*, FBList>& cachedLayerBuffers) REQUIRES(mMutex) {
-                    if (auto layerIter = cachedLayerBuffers.find(layer);
-                        layerIter != cachedLayerBuffers.end()) {
-                        auto& fbList = layerIter->second;
-                        for (auto it = fbList.begin(); it != fbList.end();) {
-                            auto bufferIter = it++;
-                            if (removedBufferDescs.count((*bufferIter)->bufferDesc)) {
-                                mCleanBuffers.splice(mCleanBuffers.end(), fbList, bufferIter);
-                                needCleanup = true;
-                            }
-                        }
+        auto destroyCachedBuffersLocked = [&](FBCacheMap& cachedLayerBuffers) REQUIRES(mMutex) {
+            if (auto layerIter = cachedLayerBuffers.find(layer);
+                layerIter != cachedLayerBuffers.end()) {
+                auto& cache = layerIter->second;
+                for (const auto& bufferDesc : removedBufferDescs) {
+                    if (auto it = cache.index.find(bufferDesc); it != cache.index.end()) {
+                        mCleanBuffers.splice(mCleanBuffers.end(), cache.fbList, it->second);
+                        cache.index.erase(it);
+                        needCleanup = true;
                     }
-                };
+                }
+            }
+        };
         destroyCachedBuffersLocked(mCachedLayerBuffers);
         destroyCachedBuffersLocked(mCachedSecureLayerBuffers);
     }
@@ -530,8 +587,11 @@ ExynosDisplayDrmInterface::~ExynosDisplayDrmInterface()
         mDrmDevice->DestroyPropertyBlob(mDesiredModeState.blob_id);
     if (mDesiredModeState.old_blob_id)
         mDrmDevice->DestroyPropertyBlob(mDesiredModeState.old_blob_id);
-    if (mPartialRegionState.blob_id)
-        mDrmDevice->DestroyPropertyBlob(mPartialRegionState.blob_id);
+
+    Mutex::Autolock lock(mAtomicPsetPoolMutex);
+    for (auto pset : mAtomicPsetPool)
+        drmModeAtomicFree(pset);
+    mAtomicPsetPool.clear();
 }
 
 void ExynosDisplayDrmInterface::init(ExynosDisplay *exynosDisplay)
@@ -728,6 +788,7 @@ int32_t ExynosDisplayDrmInterface::initDrmDevice(DrmDevice *drmDevice)
     }
 
     mFBManager.init(mDrmDevice->fd());
+    mBlobCache.init(mDrmDevice);
 
     int drmDisplayId = getDrmDisplayId(mExynosDisplay->mType, mExynosDisplay->mIndex);
     if (drmDisplayId < 0) {
@@ -1222,6 +1283,12 @@ no_mode_changes:
     return (*outNumConfigs > 0) ? HWC2_ERROR_NONE : HWC2_ERROR_BAD_DISPLAY;
 }
 
+void ExynosDisplayDrmInterface::dump(String8 &result)
+{
+    mFBManager.dump(result);
+    mBlobCache.dump(result);
+}
+
 void ExynosDisplayDrmInterface::dumpDisplayConfigs()
 {
     std::lock_guard<std::recursive_mutex> lock(mDrmConnector->modesLock());
@@ -1680,6 +1747,64 @@ int ExynosDisplayDrmInterface::getDeconChannel(ExynosMPP *otfMPP)
     return -EINVAL;
 }
 
+int32_t ExynosDisplayDrmInterface::addPlaneProperty(DrmModeAtomicReq &drmReq,
+                                                    const std::unique_ptr<DrmPlane> &plane,
+                                                    const DrmProperty &property, uint64_t value,
+                                                    bool optional)
+{
+    if (!property.id())
+        return drmReq.atomicAddProperty(plane->id(), property, value, optional);
+
+    /* The kernel keeps the plane state of the last commit, skip unchanged values */
+    {
+        Mutex::Autolock lock(mPlanePropsMutex);
+        if (const auto planeIt = mCommittedPlaneProps.find(plane->id());
+            planeIt != mCommittedPlaneProps.end()) {
+            const auto propIt = planeIt->second.find(property.id());
+            if ((propIt != planeIt->second.end()) && (propIt->second == value)) {
+                mPendingPlaneProps[plane->id()][property.id()] = value;
+                return NO_ERROR;
+            }
+        }
+    }
+
+    int32_t ret = drmReq.atomicAddProperty(plane->id(), property, value, optional);
+    if (ret == NO_ERROR)
+        mPendingPlaneProps[plane->id()][property.id()] = value;
+    return ret;
+}
+
+void ExynosDisplayDrmInterface::clearCommittedPlaneProps()
+{
+    Mutex::Autolock lock(mPlanePropsMutex);
+    mCommittedPlaneProps.clear();
+}
+
+void ExynosDisplayDrmInterface::dropCommittedPlaneProps(uint32_t planeId)
+{
+    Mutex::Autolock lock(mPlanePropsMutex);
+    mCommittedPlaneProps.erase(planeId);
+}
+
+/* Called after the frame commit of mPendingPlaneProps reached the kernel */
+void ExynosDisplayDrmInterface::commitPlaneProps()
+{
+    /* Other displays can't skip properties of the planes this commit reprogrammed */
+    for (auto display : mExynosDisplay->mDevice->mDisplays) {
+        if ((display == mExynosDisplay) || (display->mDisplayInterface == nullptr) ||
+            (display->mDisplayInterface->mType != INTERFACE_TYPE_DRM))
+            continue;
+        auto *displayIntf =
+                static_cast<ExynosDisplayDrmInterface*>(display->mDisplayInterface.get());
+        for (const auto &planeProps : mPendingPlaneProps)
+            displayIntf->dropCommittedPlaneProps(planeProps.first);
+    }
+
+    /* Planes that were not enabled by this commit drop out of the shadow state */
+    Mutex::Autolock lock(mPlanePropsMutex);
+    mCommittedPlaneProps.swap(mPendingPlaneProps);
+}
+
 int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         ExynosDisplayDrmInterface::DrmModeAtomicReq &drmReq,
         const exynos_win_config_data &config,
@@ -1704,33 +1829,33 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
     if ((ret = drmReq.atomicAddProperty(plane->id(),
                     plane->fb_property(), fbId)) < 0)
         return ret;
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->crtc_x_property(), config.dst.x)) < 0)
         return ret;
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->crtc_y_property(), config.dst.y)) < 0)
         return ret;
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->crtc_w_property(), config.dst.w)) < 0)
         return ret;
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->crtc_h_property(), config.dst.h)) < 0)
         return ret;
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->src_x_property(), (int)(config.src.x) << 16)) < 0)
         return ret;
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->src_y_property(), (int)(config.src.y) << 16)) < 0)
         HWC_LOGE(mExynosDisplay, "%s:: Failed to add src_y property to plane",
                 __func__);
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->src_w_property(), (int)(config.src.w) << 16)) < 0)
         return ret;
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->src_h_property(), (int)(config.src.h) << 16)) < 0)
         return ret;
 
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
             plane->rotation_property(),
             halTransformToDrmRot(config.transform), true)) < 0)
         return ret;
@@ -1741,7 +1866,7 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         HWC_LOGE(mExynosDisplay, "Fail to convert blend(%d)", config.blending);
         return ret;
     }
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->blend_property(), drmEnum, true)) < 0)
         return ret;
 
@@ -1751,7 +1876,7 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         // Ignore ret and use min_zpos as 0 by default
         std::tie(std::ignore, min_zpos) = plane->zpos_property().rangeMin();
 
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
+        if ((ret = addPlaneProperty(drmReq, plane,
                 plane->zpos_property(), configIndex + min_zpos)) < 0)
             return ret;
     }
@@ -1761,7 +1886,7 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         uint64_t max_alpha = 0;
         std::tie(std::ignore, min_alpha) = plane->alpha_property().rangeMin();
         std::tie(std::ignore, max_alpha) = plane->alpha_property().rangeMax();
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
+        if ((ret = addPlaneProperty(drmReq, plane,
                 plane->alpha_property(),
                 (uint64_t)(((max_alpha - min_alpha) * config.plane_alpha) + 0.5) + min_alpha, true)) < 0)
             return ret;
@@ -1776,7 +1901,7 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
     if (config.state == config.WIN_STATE_COLOR)
     {
         if (plane->colormap_property().id()) {
-            if ((ret = drmReq.atomicAddProperty(plane->id(),
+            if ((ret = addPlaneProperty(drmReq, plane,
                             plane->colormap_property(), config.color)) < 0)
                 return ret;
         } else {
@@ -1791,7 +1916,7 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
                 config.dataspace & HAL_DATASPACE_STANDARD_MASK);
         return ret;
     }
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->standard_property(),
                     drmEnum, true)) < 0)
         return ret;
@@ -1803,7 +1928,7 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
                 config.dataspace & HAL_DATASPACE_TRANSFER_MASK);
         return ret;
     }
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->transfer_property(), drmEnum, true)) < 0)
         return ret;
 
@@ -1814,40 +1939,35 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
                 config.dataspace & HAL_DATASPACE_RANGE_MASK);
         return ret;
     }
-    if ((ret = drmReq.atomicAddProperty(plane->id(),
+    if ((ret = addPlaneProperty(drmReq, plane,
                     plane->range_property(), drmEnum, true)) < 0)
         return ret;
 
     if (hasHdrInfo(config.dataspace)) {
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
+        if ((ret = addPlaneProperty(drmReq, plane,
                 plane->min_luminance_property(), config.min_luminance)) < 0)
             return ret;
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
+        if ((ret = addPlaneProperty(drmReq, plane,
                        plane->max_luminance_property(), config.max_luminance)) < 0)
             return ret;
     }
 
     if (config.state == config.WIN_STATE_RCD) {
         if (plane->block_property().id()) {
-            if (mBlockState != config.block_area) {
-                uint32_t blobId = 0;
-                ret = mDrmDevice->CreatePropertyBlob(&config.block_area, sizeof(config.block_area),
-                                                     &blobId);
-                if (ret || (blobId == 0)) {
-                    HWC_LOGE(mExynosDisplay, "Failed to create blocking region blob id=%d, ret=%d",
-                             blobId, ret);
-                    return ret;
-                }
-
-                mBlockState.mRegion = config.block_area;
-                if (mBlockState.mBlobId) {
-                    drmReq.addOldBlob(mBlockState.mBlobId);
-                }
-                mBlockState.mBlobId = blobId;
+            /* Looked up every frame so that the cache keeps the current blob alive */
+            uint32_t blobId = 0;
+            ret = mBlobCache.getBlob(drmReq, &config.block_area, sizeof(config.block_area),
+                                     blobId);
+            if (ret || (blobId == 0)) {
+                HWC_LOGE(mExynosDisplay, "Failed to create blocking region blob id=%d, ret=%d",
+                         blobId, ret);
+                return ret;
             }
+            mBlockState.mRegion = config.block_area;
+            mBlockState.mBlobId = blobId;
 
-            if ((ret = drmReq.atomicAddProperty(plane->id(), plane->block_property(),
-                                                mBlockState.mBlobId)) < 0) {
+            if ((ret = addPlaneProperty(drmReq, plane, plane->block_property(),
+                                        mBlockState.mBlobId)) < 0) {
                 HWC_LOGE(mExynosDisplay, "Failed to set blocking region property %d", ret);
                 return ret;
             }
@@ -1871,18 +1991,18 @@ int32_t ExynosDisplayDrmInterface::setupPartialRegion(DrmModeAtomicReq &drmReq)
         static_cast<unsigned short>(update_region.x + update_region.w),
         static_cast<unsigned short>(update_region.y + update_region.h),
     };
+    /* Looked up every frame so that the cache keeps the current blob alive */
+    uint32_t blob_id = 0;
+    ret = mBlobCache.getBlob(drmReq, &partial_rect, sizeof(partial_rect), blob_id);
+    if (ret || (blob_id == 0)) {
+        HWC_LOGE(mExynosDisplay, "Failed to create partial region "
+                "blob id=%d, ret=%d", blob_id, ret);
+        return ret;
+    }
+
     if ((mPartialRegionState.blob_id == 0) ||
          mPartialRegionState.isUpdated(partial_rect))
     {
-        uint32_t blob_id = 0;
-        ret = mDrmDevice->CreatePropertyBlob(&partial_rect,
-                sizeof(partial_rect),&blob_id);
-        if (ret || (blob_id == 0)) {
-            HWC_LOGE(mExynosDisplay, "Failed to create partial region "
-                    "blob id=%d, ret=%d", blob_id, ret);
-            return ret;
-        }
-
         HDEBUGLOGD(eDebugWindowUpdate,
                 "%s: partial region updated [%d, %d, %d, %d] -> [%d, %d, %d, %d] blob(%d)",
                 mExynosDisplay->mDisplayName.c_str(),
@@ -1896,11 +2016,8 @@ int32_t ExynosDisplayDrmInterface::setupPartialRegion(DrmModeAtomicReq &drmReq)
                 partial_rect.y2,
                 blob_id);
         mPartialRegionState.partial_rect = partial_rect;
-
-        if (mPartialRegionState.blob_id)
-            drmReq.addOldBlob(mPartialRegionState.blob_id);
-        mPartialRegionState.blob_id = blob_id;
     }
+    mPartialRegionState.blob_id = blob_id;
     if ((ret = drmReq.atomicAddProperty(mDrmCrtc->id(),
                     mDrmCrtc->partial_region_property(),
                     mPartialRegionState.blob_id)) < 0) {
@@ -1911,6 +2028,61 @@ int32_t ExynosDisplayDrmInterface::setupPartialRegion(DrmModeAtomicReq &drmReq)
     return ret;
 }
 
+ExynosDisplayDrmInterface::PropertyBlobCache::~PropertyBlobCache()
+{
+    Mutex::Autolock lock(mMutex);
+    for (auto &entry : mEntries) {
+        int ret = mDrmDevice->DestroyPropertyBlob(entry.blobId);
+        if (ret)
+            ALOGE("%s: Failed to destroy blob %d, ret(%d)", __func__, entry.blobId, ret);
+    }
+    mEntries.clear();
+}
+
+int32_t ExynosDisplayDrmInterface::PropertyBlobCache::getBlob(DrmModeAtomicReq &drmReq,
+                                                              const void *data, size_t length,
+                                                              uint32_t &blobId)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    const size_t hash =
+            std::hash<std::string_view>{}(std::string_view(static_cast<const char *>(data), length));
+
+    Mutex::Autolock lock(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end(); it++) {
+        if ((it->hash == hash) && (it->data.size() == length) &&
+            std::equal(it->data.begin(), it->data.end(), bytes)) {
+            mHits++;
+            mEntries.splice(mEntries.begin(), mEntries, it);
+            blobId = it->blobId;
+            return NO_ERROR;
+        }
+    }
+
+    mMisses++;
+    blobId = 0;
+    int32_t ret = mDrmDevice->CreatePropertyBlob(data, length, &blobId);
+    if (ret || (blobId == 0))
+        return ret;
+
+    /*
+     * The evicted blob may still be referenced by the previous commit,
+     * so it is destroyed together with the old blobs of drmReq.
+     */
+    if (mEntries.size() >= kMaxEntries) {
+        drmReq.addOldBlob(mEntries.back().blobId);
+        mEntries.pop_back();
+    }
+    mEntries.push_front({hash, std::vector<uint8_t>(bytes, bytes + length), blobId});
+    return NO_ERROR;
+}
+
+void ExynosDisplayDrmInterface::PropertyBlobCache::dump(String8 &result)
+{
+    Mutex::Autolock lock(mMutex);
+    result.appendFormat("PropertyBlobCache: blobs(%zu), hits(%" PRIu64 "), misses(%" PRIu64 ")\n",
+                        mEntries.size(), mHits, mMisses);
+}
+
 int32_t ExynosDisplayDrmInterface::waitVBlank() {
     drmVBlank vblank;
     uint32_t high_crtc = (mDrmCrtc->pipe() << DRM_VBLANK_HIGH_CRTC_SHIFT);
@@ -1923,6 +2095,18 @@ int32_t ExynosDisplayDrmInterface::waitVBlank() {
     return ret;
 }
 
+int32_t ExynosDisplayDrmInterface::getPredictedVsyncs(nsecs_t timeNs, size_t count,
+                                                      std::vector<nsecs_t> &outVsyncs) {
+    std::vector<int64_t> vsyncs;
+    /* -EAGAIN until the vsync model has a prediction */
+    int ret = mDrmVSyncWorker.GetPredictedVSyncs(timeNs, count, vsyncs);
+    if (ret != 0) {
+        return ret;
+    }
+    outVsyncs.assign(vsyncs.begin(), vsyncs.end());
+    return NO_ERROR;
+}
+
 int32_t ExynosDisplayDrmInterface::updateColorSettings(DrmModeAtomicReq &drmReq, uint64_t dqeEnabled) {
     int ret = NO_ERROR;
 
@@ -1969,6 +2153,7 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData()
     bool hasSecureBuffer = false;
 
     mFrameCounter++;
+    mPendingPlaneProps.clear();
 
     funcReturnCallback retCallback([&]() {
         if ((ret == NO_ERROR) && !drmReq.getError()) {
@@ -2220,8 +2405,12 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData()
     if ((ret = drmReq.commit(flags, true)) < 0) {
         HWC_LOGE(mExynosDisplay, "%s:: Failed to commit pset ret=%d in deliverWinConfigData()\n",
                 __func__, ret);
+        clearCommittedPlaneProps();
         return ret;
     }
+    /* A commit skipped in TUI has already cleared the shadow state */
+    if (!drmReq.isSkippedInTUI())
+        commitPlaneProps();
 
     mExynosDisplay->mDpuData.retire_fence = (int)out_fences[mDrmCrtc->pipe()];
     /*
@@ -2298,6 +2487,8 @@ int32_t ExynosDisplayDrmInterface::clearDisplayPlanes(DrmModeAtomicReq &drmReq)
 {
     int ret = NO_ERROR;
 
+    clearCommittedPlaneProps();
+
     /* Disable all planes */
     for (auto &plane : mDrmDevice->planes()) {
         /* Do not disable planes that are reserved to other dispaly */
@@ -2419,7 +2610,7 @@ int32_t ExynosDisplayDrmInterface::setForcePanic()
 ExynosDisplayDrmInterface::DrmModeAtomicReq::DrmModeAtomicReq(ExynosDisplayDrmInterface *displayInterface)
     : mDrmDisplayInterface(displayInterface)
 {
-    mPset = drmModeAtomicAlloc();
+    mPset = mDrmDisplayInterface->acquireAtomicPset();
     mSavedPset = NULL;
 }
 
@@ -2434,12 +2625,40 @@ ExynosDisplayDrmInterface::DrmModeAtomicReq::~DrmModeAtomicReq()
     }
 
     if(mPset)
-        drmModeAtomicFree(mPset);
+        mDrmDisplayInterface->recycleAtomicPset(mPset);
+    if (mSavedPset)
+        mDrmDisplayInterface->recycleAtomicPset(mSavedPset);
 
     if (destroyOldBlobs() != NO_ERROR)
         HWC_LOGE(mDrmDisplayInterface->mExynosDisplay, "destroy blob error");
 }
 
+drmModeAtomicReqPtr ExynosDisplayDrmInterface::acquireAtomicPset()
+{
+    {
+        Mutex::Autolock lock(mAtomicPsetPoolMutex);
+        if (!mAtomicPsetPool.empty()) {
+            drmModeAtomicReqPtr pset = mAtomicPsetPool.back();
+            mAtomicPsetPool.pop_back();
+            return pset;
+        }
+    }
+    return drmModeAtomicAlloc();
+}
+
+void ExynosDisplayDrmInterface::recycleAtomicPset(drmModeAtomicReqPtr pset)
+{
+    /* Drop the properties but keep the allocated property array */
+    drmModeAtomicSetCursor(pset, 0);
+
+    Mutex::Autolock lock(mAtomicPsetPoolMutex);
+    if (mAtomicPsetPool.size() < kMaxPooledAtomicPsets) {
+        mAtomicPsetPool.push_back(pset);
+        return;
+    }
+    drmModeAtomicFree(pset);
+}
+
 int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
         const uint32_t id,
         const DrmProperty &property,
@@ -2558,6 +2777,9 @@ int ExynosDisplayDrmInterface::DrmModeAtomicReq::commit(uint32_t flags, bool log
         dumpAtomicCommitInfo(result, true);
     if ((ret == -EPERM) && mDrmDisplayInterface->mDrmDevice->event_listener()->IsDrmInTUI()) {
         ALOGV("skip atomic commit error handling as kernel is in TUI");
+        /* The plane state left by TUI is unknown, nothing can be skipped after it */
+        mDrmDisplayInterface->clearCommittedPlaneProps();
+        mSkippedInTUI = true;
         ret = NO_ERROR;
     } else if (ret < 0) {
         if (ret == -EINVAL) {
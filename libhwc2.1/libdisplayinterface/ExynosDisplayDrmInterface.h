@@ -102,6 +102,8 @@ class FramebufferManager {
         // off
         void releaseAll();
 
+        void dump(String8& result);
+
     private:
         // this struct should contain elements that can be used to identify framebuffer more easily
         struct Framebuffer {
@@ -123,6 +125,13 @@ class FramebufferManager {
                     return isSecure < rhs.isSecure;
                 }
             };
+            struct BufferDescHash {
+                size_t operator()(const Framebuffer::BufferDesc& desc) const {
+                    return std::hash<uint64_t>{}(desc.bufferId) ^
+                            (std::hash<int>{}(desc.drmFormat) << 1) ^
+                            static_cast<size_t>(desc.isSecure);
+                }
+            };
             struct SolidColorDesc {
                 uint32_t width;
                 uint32_t height;
@@ -132,12 +141,13 @@ class FramebufferManager {
             };
 
             explicit Framebuffer(int fd, uint32_t fb, BufferDesc desc)
-                  : drmFd(fd), fbId(fb), bufferDesc(desc){};
+                  : drmFd(fd), fbId(fb), isSolidColor(false), bufferDesc(desc){};
             explicit Framebuffer(int fd, uint32_t fb, SolidColorDesc desc)
-                  : drmFd(fd), fbId(fb), colorDesc(desc){};
+                  : drmFd(fd), fbId(fb), isSolidColor(true), colorDesc(desc){};
             ~Framebuffer() { drmModeRmFB(drmFd, fbId); };
             int drmFd;
             uint32_t fbId;
+            bool isSolidColor;
             union {
                 BufferDesc bufferDesc;
                 SolidColorDesc colorDesc;
@@ -145,9 +155,21 @@ class FramebufferManager {
         };
         using FBList = std::list<std::unique_ptr<Framebuffer>>;
 
-        template <class UnaryPredicate>
+        // Framebuffers of a layer ordered from the most recently used one. Buffer framebuffers
+        // are also indexed by BufferDesc so that a lookup doesn't walk the list.
+        struct FBCache {
+            FBList fbList;
+            std::unordered_map<Framebuffer::BufferDesc, FBList::iterator,
+                               Framebuffer::BufferDescHash>
+                    index;
+        };
+        using FBCacheMap = std::unordered_map<const ExynosLayer*, FBCache>;
+
+        uint32_t findCachedFbId(const ExynosLayer* layer, const bool isSecureBuffer,
+                                const Framebuffer::BufferDesc& bufferDesc);
         uint32_t findCachedFbId(const ExynosLayer* layer, const bool isSecureBuffer,
-                                UnaryPredicate predicate);
+                                const Framebuffer::SolidColorDesc& colorDesc);
+        void evictLeastRecentlyUsedLocked(FBCache& cache) REQUIRES(mMutex);
         int addFB2WithModifiers(uint32_t state, uint32_t width, uint32_t height, uint32_t drmFormat,
                                 const DrmArray<uint32_t> &handles,
                                 const DrmArray<uint32_t> &pitches,
@@ -168,11 +190,11 @@ class FramebufferManager {
 
         int mDrmFd = -1;
 
-        // mCachedLayerBuffers map keep the relationship between Layer and FBList.
+        // mCachedLayerBuffers map keep the relationship between Layer and FBCache.
         // mCachedSecureLayerBuffers map keep the relationship between secure
-        // Layer and FBList. The map entry will be deleted once the layer is destroyed.
-        std::map<const ExynosLayer *, FBList> mCachedLayerBuffers;
-        std::map<const ExynosLayer*, FBList> mCachedSecureLayerBuffers;
+        // Layer and FBCache. The map entry will be deleted once the layer is destroyed.
+        FBCacheMap mCachedLayerBuffers;
+        FBCacheMap mCachedSecureLayerBuffers;
 
         // mCleanBuffers list keeps fbIds of destroyed layers. Those fbIds will
         // be destroyed in mRmFBThread thread.
@@ -194,23 +216,16 @@ class FramebufferManager {
         Condition mFlipDone;
         Mutex mMutex;
 
+        uint64_t mCacheHits GUARDED_BY(mMutex) = 0;
+        uint64_t mCacheMisses GUARDED_BY(mMutex) = 0;
+        uint64_t mCacheEvictions GUARDED_BY(mMutex) = 0;
+
         static constexpr size_t MAX_CACHED_LAYERS = 16;
         static constexpr size_t MAX_CACHED_SECURE_LAYERS = 1;
         static constexpr size_t MAX_CACHED_BUFFERS_PER_LAYER = 32;
         static constexpr size_t MAX_CACHED_SECURE_BUFFERS_PER_LAYER = 3;
 };
 
-template <class UnaryPredicate>
-uint32_t FramebufferManager::findCachedFbId(const ExynosLayer* layer, const bool isSecureBuffer,
-                                            UnaryPredicate predicate) {
-    Mutex::Autolock lock(mMutex);
-    markInuseLayerLocked(layer, isSecureBuffer);
-    const auto& cachedBuffers =
-            (!isSecureBuffer) ? mCachedLayerBuffers[layer] : mCachedSecureLayerBuffers[layer];
-    const auto it = std::find_if(cachedBuffers.begin(), cachedBuffers.end(), predicate);
-    return (it != cachedBuffers.end()) ? (*it)->fbId : 0;
-}
-
 class ExynosDisplayDrmInterface :
     public ExynosDisplayInterface,
     public VsyncCallback
@@ -233,7 +248,7 @@ class ExynosDisplayDrmInterface :
                 }
                 void restorePset() {
                     if (mPset) {
-                        drmModeAtomicFree(mPset);
+                        mDrmDisplayInterface->recycleAtomicPset(mPset);
                     }
                     mPset = mSavedPset;
                     mSavedPset = NULL;
@@ -241,6 +256,8 @@ class ExynosDisplayDrmInterface :
 
                 void setError(int err) { mError = err; };
                 int getError() { return mError; };
+                /* commit() returned success but the kernel in TUI didn't apply it */
+                bool isSkippedInTUI() { return mSkippedInTUI; };
                 int32_t atomicAddProperty(const uint32_t id,
                         const DrmProperty &property,
                         uint64_t value, bool optional = false);
@@ -271,6 +288,7 @@ class ExynosDisplayDrmInterface :
                 drmModeAtomicReqPtr mPset;
                 drmModeAtomicReqPtr mSavedPset;
                 int mError = 0;
+                bool mSkippedInTUI = false;
                 ExynosDisplayDrmInterface *mDrmDisplayInterface = NULL;
                 /* Destroy old blobs after commit */
                 std::vector<uint32_t> mOldBlobs;
@@ -323,6 +341,7 @@ class ExynosDisplayDrmInterface :
                 uint32_t* outNumConfigs,
                 hwc2_config_t* outConfigs);
         virtual void dumpDisplayConfigs();
+        virtual void dump(String8& result) override;
         virtual bool supportDataspace(int32_t dataspace);
         virtual int32_t getColorModes(uint32_t* outNumModes, int32_t* outModes);
         virtual int32_t setColorMode(int32_t mode);
@@ -369,6 +388,8 @@ class ExynosDisplayDrmInterface :
         virtual int32_t getDefaultModeId(int32_t *modeId) override;
 
         virtual int32_t waitVBlank();
+        virtual int32_t getPredictedVsyncs(nsecs_t timeNs, size_t count,
+                                           std::vector<nsecs_t>& outVsyncs) override;
         float getDesiredRefreshRate() { return mDesiredModeState.mode.v_refresh(); }
         int32_t getOperationRate() {
             if (mExynosDisplay->mOperationRateManager) {
@@ -511,6 +532,9 @@ class ExynosDisplayDrmInterface :
         int32_t clearDisplayPlanes(DrmModeAtomicReq &drmReq);
         int32_t choosePreferredConfig();
         int getDeconChannel(ExynosMPP *otfMPP);
+        int32_t addPlaneProperty(DrmModeAtomicReq &drmReq, const std::unique_ptr<DrmPlane> &plane,
+                                 const DrmProperty &property, uint64_t value,
+                                 bool optional = false);
         /*
          * This function adds FB and gets new fb id if fbId is 0,
          * if fbId is not 0, this reuses fbId.
@@ -564,6 +588,39 @@ class ExynosDisplayDrmInterface :
             inline bool operator!=(const decon_win_rect &rhs) const { return !(*this == rhs); }
         };
 
+        /*
+         * Keeps the blobs of recently used property values alive, so that a
+         * value coming back, e.g. a partial update region toggling with full
+         * screen updates, reuses its blob id instead of creating a new blob.
+         */
+        class PropertyBlobCache {
+            public:
+                ~PropertyBlobCache();
+                void init(DrmDevice *drmDevice) { mDrmDevice = drmDevice; };
+                /*
+                 * Get the blob holding data, creating it on a miss. A blob
+                 * evicted by this call is destroyed once drmReq is committed.
+                 */
+                int32_t getBlob(DrmModeAtomicReq &drmReq, const void *data, size_t length,
+                                uint32_t &blobId);
+                void dump(String8 &result);
+
+            private:
+                struct Entry {
+                    size_t hash;
+                    std::vector<uint8_t> data;
+                    uint32_t blobId;
+                };
+                static constexpr size_t kMaxEntries = 8;
+
+                DrmDevice *mDrmDevice = NULL;
+                Mutex mMutex;
+                /* Ordered from the most recently used one */
+                std::list<Entry> mEntries GUARDED_BY(mMutex);
+                uint64_t mHits GUARDED_BY(mMutex) = 0;
+                uint64_t mMisses GUARDED_BY(mMutex) = 0;
+        };
+
         class DrmReadbackInfo {
             public:
                 void init(DrmDevice *drmDevice, uint32_t displayId);
@@ -603,6 +660,22 @@ class ExynosDisplayDrmInterface :
         ModeState mDesiredModeState;
         PartialRegionState mPartialRegionState;
         BlockingRegionState mBlockState;
+        PropertyBlobCache mBlobCache;
+        /*
+         * Plane property values of the last successful frame commit keyed by
+         * plane id and property id. Only planes enabled by that commit are kept,
+         * and addPlaneProperty() leaves out a property whose value didn't change.
+         * A plane enabled by another display is dropped by that display's commit,
+         * hence the lock.
+         */
+        using PlanePropertyValues =
+                std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint64_t>>;
+        void clearCommittedPlaneProps();
+        void dropCommittedPlaneProps(uint32_t planeId);
+        void commitPlaneProps();
+        Mutex mPlanePropsMutex;
+        PlanePropertyValues mCommittedPlaneProps GUARDED_BY(mPlanePropsMutex);
+        PlanePropertyValues mPendingPlaneProps;
         /* Mapping plane id to ExynosMPP, key is plane id */
         std::unordered_map<uint32_t, ExynosMPP*> mExynosMPPsForPlane;
 
@@ -617,6 +690,18 @@ class ExynosDisplayDrmInterface :
 
         DrmReadbackInfo mReadbackInfo;
         FramebufferManager mFBManager;
+
+        /*
+         * Property sets of finished atomic requests are kept here and reused by
+         * the next DrmModeAtomicReq, so that a frame commit doesn't allocate and
+         * grow a new property array every time.
+         */
+        drmModeAtomicReqPtr acquireAtomicPset();
+        void recycleAtomicPset(drmModeAtomicReqPtr pset);
+        static constexpr size_t kMaxPooledAtomicPsets = 4;
+        Mutex mAtomicPsetPoolMutex;
+        std::vector<drmModeAtomicReqPtr> mAtomicPsetPool GUARDED_BY(mAtomicPsetPoolMutex);
+
         std::array<uint8_t, MONITOR_DESCRIPTOR_DATA_LENGTH> mMonitorDescription;
         nsecs_t mLastDumpDrmAtomicMessageTime;
         bool mIsResolutionSwitchInProgress = false;
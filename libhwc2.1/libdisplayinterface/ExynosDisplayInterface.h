@@ -44,6 +44,7 @@ class ExynosDisplayInterface {
                 uint32_t* outNumConfigs,
                 hwc2_config_t* outConfigs);
         virtual void dumpDisplayConfigs() {};
+        virtual void dump(String8& __unused result){};
         virtual bool supportDataspace(int32_t __unused dataspace) { return true; };
         virtual int32_t getColorModes(uint32_t* outNumModes, int32_t* outModes);
         virtual int32_t setColorMode(int32_t __unused mode) {return NO_ERROR;};
@@ -89,6 +90,11 @@ class ExynosDisplayInterface {
         virtual uint32_t getActiveModeId() { return UINT_MAX; }
 
         virtual int32_t waitVBlank() { return 0; };
+        /* Predicted timestamps of the next count vsyncs at or after timeNs */
+        virtual int32_t getPredictedVsyncs(nsecs_t __unused timeNs, size_t __unused count,
+                                           std::vector<nsecs_t>& __unused outVsyncs) {
+            return HWC2_ERROR_UNSUPPORTED;
+        }
 
         virtual bool readHotplugStatus() { return true; };
         virtual int readHotplugErrorCode() { return 0; };
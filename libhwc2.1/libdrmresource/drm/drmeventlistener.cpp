@@ -28,6 +28,7 @@
 #include <log/log.h>
 #include <sys/socket.h>
 #include <utils/String8.h>
+#include <utils/Timers.h>
 #include <xf86drm.h>
 
 #include "drmdevice.h"
@@ -271,53 +272,115 @@ void DrmEventListener::FlipHandler(int /* fd */, unsigned int /* sequence */,
   delete handler;
 }
 
+void DrmEventListener::RecordDispatch(DispatchType type) {
+  DispatchStats &stats = dispatch_stats_[type];
+  uint64_t latency = systemTime(SYSTEM_TIME_MONOTONIC) - wakeup_ns_;
+
+  stats.count++;
+  stats.total_ns += latency;
+  if (latency > stats.max_ns)
+    stats.max_ns = latency;
+}
+
+void DrmEventListener::DumpDispatchStats(String8 &result) {
+  static constexpr const char *kDispatchNames[DISPATCH_MAX] = {
+      "hotplug", "property_update", "panel_idle", "tui", "sysfs", "histogram", "flip",
+  };
+
+  result.appendFormat("DrmEventListener dispatch latency (us):\n");
+  for (uint32_t i = 0; i < DISPATCH_MAX; i++) {
+    uint64_t count = dispatch_stats_[i].count;
+    if (count == 0)
+      continue;
+    result.appendFormat("\t%-16s count %" PRIu64 ", avg %" PRIu64 ", max %" PRIu64 "\n",
+                        kDispatchNames[i], count, dispatch_stats_[i].total_ns / count / 1000,
+                        dispatch_stats_[i].max_ns / 1000);
+  }
+}
+
+/* Matches "<key><unsigned>" where key includes the '=' */
+template <size_t N>
+static bool ParseUEventValue(const char *event, const char (&key)[N], unsigned *value) {
+  if (strncmp(event, key, N - 1))
+    return false;
+
+  char *end;
+  unsigned long parsed = strtoul(event + N - 1, &end, 10);
+  if (end == event + N - 1)
+    return false;
+
+  *value = parsed;
+  return true;
+}
+
 void DrmEventListener::UEventHandler() {
-  char buffer[1024];
+  char buffer[kUEventBufferSize + 1];
   int ret;
 
-  struct timespec ts;
-  uint64_t timestamp = 0;
-  ret = clock_gettime(CLOCK_MONOTONIC, &ts);
-  if (!ret)
-    timestamp = ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
-  else
-    ALOGE("Failed to get monotonic clock on hotplug %d", ret);
+  uint64_t timestamp = wakeup_ns_;
 
-  ret = read(uevent_fd_.get(), &buffer, sizeof(buffer));
-  if (ret == 0) {
-    return;
-  } else if (ret < 0) {
-    ALOGE("Got error reading uevent %d", ret);
-    return;
+  // Drain the uevents queued since the last wakeup
+  for (uint32_t n = 0; n < kMaxUEventsPerWakeup; n++) {
+    ret = recv(uevent_fd_.get(), &buffer, kUEventBufferSize, MSG_DONTWAIT);
+    if (ret == 0) {
+      return;
+    } else if (ret < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        ALOGE("Got error reading uevent %d", -errno);
+      return;
+    }
+
+    buffer[ret] = '\0';
+    HandleUEvent(buffer, ret, timestamp);
   }
+}
+
+void DrmEventListener::HandleUEvent(const char *buffer, int len, uint64_t timestamp) {
+  // Kernel uevents start with "ACTION@DEVPATH", skip anything else
+  if (!memchr(buffer, '@', strnlen(buffer, len)))
+    return;
 
   bool drm_event = false, hotplug_event = false;
   bool have_connector_id = false, have_property_id = false;
   unsigned connector_id = 0;
   unsigned updated_property_id = 0;
-  for (int i = 0; i < ret;) {
-    char *event = buffer + i;
-
-    if (!strcmp(event, "DEVTYPE=drm_minor")) {
-      drm_event = true;
-    } else if (!strncmp(event, "PANEL_IDLE_ENTER=", strlen("PANEL_IDLE_ENTER="))) {
-      panel_idle_handler_->handleIdleEnterEvent(event);
-    } else if (!strcmp(event, "HOTPLUG=1")) {
-      hotplug_event = true;
-    } else if (sscanf(event, "CONNECTOR=%u", &connector_id) == 1) {
-      have_connector_id = true;
-    } else if (sscanf(event, "PROPERTY=%u", &updated_property_id) == 1) {
-      have_property_id = true;
+  for (const char *event = buffer; event < buffer + len; event += strlen(event) + 1) {
+    // Most keys of unrelated devices are rejected by their first character
+    switch (event[0]) {
+      case 'D':
+        if (!strcmp(event, "DEVTYPE=drm_minor"))
+          drm_event = true;
+        break;
+      case 'H':
+        if (!strcmp(event, "HOTPLUG=1"))
+          hotplug_event = true;
+        break;
+      case 'C':
+        if (ParseUEventValue(event, "CONNECTOR=", &connector_id))
+          have_connector_id = true;
+        break;
+      case 'P':
+        if (!strncmp(event, "PANEL_IDLE_ENTER=", strlen("PANEL_IDLE_ENTER="))) {
+          if (panel_idle_handler_) {
+            panel_idle_handler_->handleIdleEnterEvent(event);
+            RecordDispatch(DISPATCH_PANEL_IDLE);
+          }
+        } else if (ParseUEventValue(event, "PROPERTY=", &updated_property_id)) {
+          have_property_id = true;
+        }
+        break;
+      default:
+        break;
     }
-
-    i += strlen(event) + 1;
   }
 
   // Property updates also have HOTPLUG=1 string, so must be handled
   // first. Actual hotplug events don't have property id.
   if (have_connector_id && have_property_id) {
-    if (drm_prop_update_handler_)
+    if (drm_prop_update_handler_) {
       drm_prop_update_handler_->handleDrmPropertyUpdate(connector_id, updated_property_id);
+      RecordDispatch(DISPATCH_PROPERTY_UPDATE);
+    }
     return;
   }
 
@@ -326,6 +389,7 @@ void DrmEventListener::UEventHandler() {
       return;
 
     hotplug_handler_->handleEvent(timestamp);
+    RecordDispatch(DISPATCH_HOTPLUG);
   }
 }
 
@@ -350,6 +414,7 @@ void DrmEventListener::DRMEventHandler() {
                     histo = (struct exynos_drm_histogram_event *)e;
                     histogram_handler_->handleHistogramEvent(histo->crtc_id,
                                                              (void *)&(histo->bins));
+                    RecordDispatch(DISPATCH_HISTOGRAM);
                 }
                 break;
 #if defined(EXYNOS_DRM_HISTOGRAM_CHANNEL_EVENT)
@@ -375,6 +440,7 @@ void DrmEventListener::DRMEventHandler() {
                 user_data = (void *)(unsigned long)(vblank->user_data);
                 FlipHandler(drm_->fd(), vblank->sequence, vblank->tv_sec, vblank->tv_usec,
                             user_data);
+                RecordDispatch(DISPATCH_FLIP);
                 break;
             case DRM_EVENT_VBLANK:
             case DRM_EVENT_CRTC_SEQUENCE:
@@ -396,6 +462,7 @@ void DrmEventListener::TUIEventHandler() {
   }
 
   tui_handler_->handleTUIEvent();
+  RecordDispatch(DISPATCH_TUI);
 }
 
 void DrmEventListener::SysfsEventHandler(int fd) {
@@ -410,6 +477,7 @@ void DrmEventListener::SysfsEventHandler(int fd) {
   }
   if (handler) {
     handler->handleSysfsEvent();
+    RecordDispatch(DISPATCH_SYSFS);
   } else {
     ALOGW("Unhandled sysfs event from fd:%d", fd);
   }
@@ -422,6 +490,7 @@ void DrmEventListener::Routine() {
   do {
     nfds = epoll_wait(epoll_fd_.get(), events, maxFds, -1);
   } while (nfds <= 0);
+  wakeup_ns_ = systemTime(SYSTEM_TIME_MONOTONIC);
 
   for (n = 0; n < nfds; n++) {
     if (events[n].events & EPOLLIN) {
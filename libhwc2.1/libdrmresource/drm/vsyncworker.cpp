@@ -22,6 +22,7 @@
 
 #include <hardware/hardware.h>
 #include <log/log.h>
+#include <math.h>
 #include <stdlib.h>
 #include <time.h>
 #include <utils/Trace.h>
@@ -39,6 +40,114 @@ constexpr auto nsecsPerSec = std::chrono::nanoseconds(1s).count();
 
 namespace android {
 
+void VsyncModel::resetLocked() {
+    mSampleCount = 0;
+    mNextSample = 0;
+    mLastSample = {0, -1};
+    mOutliers = 0;
+    mNominalPeriodNs = 0;
+    mFitted = false;
+}
+
+bool VsyncModel::isModeSwitchLocked(int64_t nominalPeriodNs) const {
+    return mNominalPeriodNs != 0 &&
+            fabs(nominalPeriodNs - mNominalPeriodNs) > kModeSwitchThreshold * mNominalPeriodNs;
+}
+
+void VsyncModel::addSampleLocked(const Sample &sample) {
+    mSamples[mNextSample] = sample;
+    mNextSample = (mNextSample + 1) % kSampleCount;
+    if (mSampleCount < kSampleCount) mSampleCount++;
+    mLastSample = sample;
+}
+
+void VsyncModel::addSample(int64_t timestampNs, int64_t nominalPeriodNs) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (nominalPeriodNs <= 0) return;
+
+    // Start over after a mode switch or a long gap (vsync was off)
+    if (isModeSwitchLocked(nominalPeriodNs) ||
+        (mLastSample.timestampNs >= 0 &&
+         timestampNs - mLastSample.timestampNs > kMaxExtrapolationNs)) {
+        resetLocked();
+    }
+    mNominalPeriodNs = nominalPeriodNs;
+
+    if (mLastSample.timestampNs < 0) {
+        addSampleLocked({0, timestampNs});
+        return;
+    }
+    if (timestampNs <= mLastSample.timestampNs) return;
+
+    // Vblanks may be missed, so index the sample by the periods elapsed
+    double periodNs = mFitted ? mPeriodNs : nominalPeriodNs;
+    int64_t elapsed = llround((timestampNs - mLastSample.timestampNs) / periodNs);
+    if (elapsed <= 0) return;
+
+    if (mFitted) {
+        double predictedNs = mLastSample.timestampNs + mOffsetNs + mPeriodNs * elapsed;
+        if (fabs(timestampNs - predictedNs) > kOutlierThreshold * mPeriodNs) {
+            if (++mOutliers < kMaxOutliers) return;
+            // The TE phase moved, the old samples no longer describe it
+            resetLocked();
+            mNominalPeriodNs = nominalPeriodNs;
+            addSampleLocked({0, timestampNs});
+            return;
+        }
+    }
+    mOutliers = 0;
+
+    addSampleLocked({mLastSample.index + elapsed, timestampNs});
+    fitLocked();
+}
+
+void VsyncModel::fitLocked() {
+    mFitted = false;
+    if (mSampleCount < kMinSamples) return;
+
+    // Relative to the last sample to keep the sums small
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (size_t i = 0; i < mSampleCount; i++) {
+        double x = mSamples[i].index - mLastSample.index;
+        double y = mSamples[i].timestampNs - mLastSample.timestampNs;
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+
+    double n = mSampleCount;
+    double denom = n * sumXX - sumX * sumX;
+    if (denom == 0) return;
+
+    double periodNs = (n * sumXY - sumX * sumY) / denom;
+    if (fabs(periodNs - mNominalPeriodNs) > kOutlierThreshold * mNominalPeriodNs) return;
+
+    mPeriodNs = periodNs;
+    mOffsetNs = (sumY - periodNs * sumX) / n;
+    mFitted = true;
+}
+
+int64_t VsyncModel::nextVsync(int64_t timeNs, int64_t nominalPeriodNs) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mFitted || (nominalPeriodNs != 0 && isModeSwitchLocked(nominalPeriodNs)) ||
+        timeNs - mLastSample.timestampNs > kMaxExtrapolationNs) {
+        return -1;
+    }
+
+    double anchorNs = mLastSample.timestampNs + mOffsetNs;
+    double periods = ceil((timeNs - anchorNs) / mPeriodNs);
+    int64_t vsyncNs = static_cast<int64_t>(ceil(anchorNs + periods * mPeriodNs));
+    return (vsyncNs < timeNs) ? static_cast<int64_t>(ceil(vsyncNs + mPeriodNs)) : vsyncNs;
+}
+
+int64_t VsyncModel::getPeriod() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFitted ? llround(mPeriodNs) : 0;
+}
+
 VSyncWorker::VSyncWorker()
     : Worker("vsync", 2, true),
       mDrmDevice(NULL),
@@ -55,6 +164,7 @@ int VSyncWorker::Init(DrmDevice *drm, int display, const String8 &displayTraceNa
     mDisplay = display;
     mDisplayTraceName = displayTraceName;
     mHwVsyncPeriodTag.appendFormat("HWVsyncPeriod for %s", displayTraceName.c_str());
+    mHwVsyncModelPeriodTag.appendFormat("HWVsyncModelPeriod for %s", displayTraceName.c_str());
     mHwVsyncEnabledTag.appendFormat("HWCVsync for %s", displayTraceName.c_str());
 
     return InitWorker();
@@ -77,8 +187,20 @@ void VSyncWorker::VSyncControl(bool enabled) {
     Signal();
 }
 
+int VSyncWorker::GetPredictedVSyncs(int64_t timeNs, size_t count, std::vector<int64_t> &outVsyncs) {
+    outVsyncs.clear();
+    for (size_t i = 0; i < count; i++) {
+        int64_t vsyncNs = mVsyncModel.nextVsync(timeNs);
+        if (vsyncNs < 0) return -EAGAIN;
+        outVsyncs.push_back(vsyncNs);
+        timeNs = vsyncNs + 1;
+    }
+    return 0;
+}
+
 /*
- * Returns the timestamp of the next vsync in phase with mLastTimestampNs.
+ * Returns the timestamp of the next vsync predicted by mVsyncModel, or
+ * without a fit, the next vsync in phase with mLastTimestampNs.
  * For example:
  *  mLastTimestampNs = 137
  *  vsyncPeriodNs = 50
@@ -99,6 +221,12 @@ int VSyncWorker::GetPhasedVSync(uint32_t vsyncPeriodNs, int64_t &expectTimeNs) {
     }
 
     int64_t currentTimeNs = now.tv_sec * nsecsPerSec + now.tv_nsec;
+    int64_t predictedTimeNs = mVsyncModel.nextVsync(currentTimeNs + 1, vsyncPeriodNs);
+    if (predictedTimeNs >= 0) {
+        expectTimeNs = predictedTimeNs;
+        return 0;
+    }
+
     if (mLastTimestampNs < 0) {
         expectTimeNs = currentTimeNs + vsyncPeriodNs;
         return -EAGAIN;
@@ -185,6 +313,14 @@ void VSyncWorker::Routine() {
     } else {
         timestampNs = (int64_t)vblank.reply.tval_sec * nsecsPerSec +
                 (int64_t)vblank.reply.tval_usec * 1000;
+
+        // Only hardware timestamps feed the model
+        DrmConnector *conn = mDrmDevice->GetConnectorForDisplay(display);
+        if (conn && conn->active_mode().te_period() != 0.0f) {
+            mVsyncModel.addSample(timestampNs,
+                                  static_cast<int64_t>(conn->active_mode().te_period()));
+            ATRACE_INT64(mHwVsyncModelPeriodTag.c_str(), mVsyncModel.getPeriod());
+        }
     }
 
     /*
@@ -18,7 +18,10 @@
 #define ANDROID_DRM_EVENT_LISTENER_H_
 
 #include <sys/epoll.h>
+#include <utils/String8.h>
 
+#include <array>
+#include <atomic>
 #include <map>
 
 #include "autofd.h"
@@ -103,8 +106,23 @@ class DrmPropertyUpdateHandler {
 class DrmEventListener : public Worker {
   static constexpr const char kTUIStatusPath[] = "/sys/devices/platform/exynos-drm/tui_status";
   static const uint32_t maxFds = 4;
+  /* Largest uevent the kernel sends (UEVENT_BUFFER_SIZE) */
+  static constexpr size_t kUEventBufferSize = 2048;
+  /* Bounds the uevents drained per wakeup so the other fds are not starved */
+  static constexpr uint32_t kMaxUEventsPerWakeup = 16;
 
  public:
+  enum DispatchType : uint32_t {
+    DISPATCH_HOTPLUG = 0,
+    DISPATCH_PROPERTY_UPDATE,
+    DISPATCH_PANEL_IDLE,
+    DISPATCH_TUI,
+    DISPATCH_SYSFS,
+    DISPATCH_HISTOGRAM,
+    DISPATCH_FLIP,
+    DISPATCH_MAX,
+  };
+
   DrmEventListener(DrmDevice *drm);
   virtual ~DrmEventListener();
 
@@ -133,6 +151,9 @@ class DrmEventListener : public Worker {
 
   bool IsDrmInTUI();
 
+  /* Time from the epoll wakeup until each kind of handler has returned */
+  void DumpDispatchStats(String8 &result);
+
   static void FlipHandler(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec,
                           void *user_data);
 
@@ -140,7 +161,15 @@ class DrmEventListener : public Worker {
   virtual void Routine();
 
  private:
+  struct DispatchStats {
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> total_ns = 0;
+    std::atomic<uint64_t> max_ns = 0;
+  };
+
+  void RecordDispatch(DispatchType type);
   void UEventHandler();
+  void HandleUEvent(const char *buffer, int len, uint64_t timestamp);
   void DRMEventHandler();
   void TUIEventHandler();
   void SysfsEventHandler(int fd);
@@ -159,6 +188,9 @@ class DrmEventListener : public Worker {
   std::shared_ptr<DrmPropertyUpdateHandler> drm_prop_update_handler_;
   std::mutex mutex_;
   std::map<int, std::shared_ptr<DrmSysfsEventHandler>> sysfs_handlers_;
+
+  int64_t wakeup_ns_ = 0;
+  std::array<DispatchStats, DISPATCH_MAX> dispatch_stats_;
 };
 
 }  // namespace android
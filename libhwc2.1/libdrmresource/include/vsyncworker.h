@@ -22,7 +22,10 @@
 #include <stdint.h>
 #include <utils/String8.h>
 
+#include <array>
 #include <map>
+#include <mutex>
+#include <vector>
 
 #include "drmdevice.h"
 #include "worker.h"
@@ -35,6 +38,58 @@ class VsyncCallback {
         virtual void Callback(int display, int64_t timestamp) = 0;
 };
 
+/*
+ * Fits the vsync period and phase to the latest hardware vblank timestamps
+ * with least squares, so that synthetic vsyncs and present time predictions
+ * follow the panel TE rather than the nominal period of the mode.
+ */
+class VsyncModel {
+    public:
+        void addSample(int64_t timestampNs, int64_t nominalPeriodNs);
+        /*
+         * First predicted vsync at or after timeNs, or -1 without a recent fit.
+         * A nominalPeriodNs other than 0 also rejects a fit made for another
+         * mode.
+         */
+        int64_t nextVsync(int64_t timeNs, int64_t nominalPeriodNs = 0) const;
+        /* Fitted period, or 0 without a fit */
+        int64_t getPeriod() const;
+
+    private:
+        static constexpr size_t kSampleCount = 16;
+        static constexpr size_t kMinSamples = 4;
+        /* Predictions are not made further than this from the last sample */
+        static constexpr int64_t kMaxExtrapolationNs = 1000000000;
+        /* A nominal period change beyond this fraction is a mode switch */
+        static constexpr double kModeSwitchThreshold = 0.01;
+        /* A sample further than this fraction of a period from the fit is an outlier */
+        static constexpr double kOutlierThreshold = 0.25;
+        /* Consecutive outliers after which the TE is considered to have moved */
+        static constexpr uint32_t kMaxOutliers = 2;
+
+        struct Sample {
+            int64_t index;
+            int64_t timestampNs;
+        };
+
+        void resetLocked();
+        void addSampleLocked(const Sample& sample);
+        void fitLocked();
+        bool isModeSwitchLocked(int64_t nominalPeriodNs) const;
+
+        mutable std::mutex mMutex;
+        std::array<Sample, kSampleCount> mSamples;
+        size_t mSampleCount = 0;
+        size_t mNextSample = 0;
+        Sample mLastSample = {0, -1};
+        uint32_t mOutliers = 0;
+        int64_t mNominalPeriodNs = 0;
+        /* Fit of timestamp = mLastSample.timestampNs + mOffsetNs + mPeriodNs * (index - mLastSample.index) */
+        bool mFitted = false;
+        double mPeriodNs = 0;
+        double mOffsetNs = 0;
+};
+
 class VSyncWorker : public Worker {
     public:
         VSyncWorker();
@@ -45,6 +100,9 @@ class VSyncWorker : public Worker {
 
         void VSyncControl(bool enabled);
 
+        /* Predicted timestamps of the next count vsyncs at or after timeNs */
+        int GetPredictedVSyncs(int64_t timeNs, size_t count, std::vector<int64_t>& outVsyncs);
+
     protected:
         void Routine() override;
 
@@ -62,7 +120,9 @@ class VSyncWorker : public Worker {
         int mDisplay;
         std::atomic_bool mEnabled;
         int64_t mLastTimestampNs;
+        VsyncModel mVsyncModel;
         String8 mHwVsyncPeriodTag;
+        String8 mHwVsyncModelPeriodTag;
         String8 mHwVsyncEnabledTag;
         String8 mDisplayTraceName;
 };
@@ -83,6 +83,8 @@ int ExynosExternalDisplay::openExternalDisplay()
     mPlugState = true;
 
     if (mLayers.size() != 0) {
+        for (size_t i = 0; i < mLayers.size(); i++)
+            mLayerRegistry.erase(mLayers[i]);
         mLayers.clear();
     }
 
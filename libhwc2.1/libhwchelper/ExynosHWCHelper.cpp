@@ -24,8 +24,10 @@
 #include <sys/mman.h>
 #include <utils/CallStack.h>
 #include <utils/Errors.h>
+#include <utils/Timers.h>
 
 #include <iomanip>
+#include <unordered_map>
 
 #include "ExynosHWC.h"
 #include "ExynosHWCDebug.h"
@@ -132,24 +134,58 @@ unsigned int isNarrowRgb(int format, android_dataspace data_space)
     }
 }
 
-const format_description_t* halFormatToExynosFormat(int inHalFormat, uint32_t inCompressType) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        const int descHalFormat = exynos_format_desc[i].halFormat;
+/*
+ * exynos_format_desc indexed by HAL and DPU format. Every entry of a HAL format
+ * is kept in table order, so a lookup returns the same entry a linear scan
+ * of the table would.
+ */
+namespace {
+struct FormatIndex {
+    std::unordered_map<int, std::vector<const format_description_t*>> halFormats;
+    std::unordered_map<int, const format_description_t*> dpuFormats;
+};
 
-        if ((inHalFormat == descHalFormat) &&
-            exynos_format_desc[i].isCompressionSupported(inCompressType)) {
-            return &exynos_format_desc[i];
+const FormatIndex& getFormatIndex() {
+    static const FormatIndex index = [] {
+        FormatIndex index;
+        for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
+            index.halFormats[exynos_format_desc[i].halFormat].push_back(&exynos_format_desc[i]);
+            index.dpuFormats.emplace(exynos_format_desc[i].s3cFormat, &exynos_format_desc[i]);
         }
+        return index;
+    }();
+    return index;
+}
+
+const format_description_t* findHalFormat(int format) {
+    const auto& halFormats = getFormatIndex().halFormats;
+    auto it = halFormats.find(format);
+    return (it != halFormats.end()) ? it->second.front() : nullptr;
+}
+
+const format_description_t* findDpuFormat(decon_pixel_format format) {
+    const auto& dpuFormats = getFormatIndex().dpuFormats;
+    auto it = dpuFormats.find(format);
+    return (it != dpuFormats.end()) ? it->second : nullptr;
+}
+} // namespace
+
+const format_description_t* halFormatToExynosFormat(int inHalFormat, uint32_t inCompressType) {
+    const auto& halFormats = getFormatIndex().halFormats;
+    auto it = halFormats.find(inHalFormat);
+    if (it == halFormats.end()) return nullptr;
+
+    for (auto desc : it->second) {
+        if (desc->isCompressionSupported(inCompressType)) return desc;
     }
     return nullptr;
 }
 
 uint8_t formatToBpp(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].halFormat == format)
-            return exynos_format_desc[i].bpp;
-    }
+    auto desc = findHalFormat(format);
+    if (desc != nullptr)
+        return desc->bpp;
 
     ALOGW("unrecognized pixel format %u", format);
     return 0;
@@ -157,25 +193,18 @@ uint8_t formatToBpp(int format)
 
 uint8_t DpuFormatToBpp(decon_pixel_format format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].s3cFormat == format)
-            return exynos_format_desc[i].bpp;
-    }
+    auto desc = findDpuFormat(format);
+    if (desc != nullptr)
+        return desc->bpp;
+
     ALOGW("unrecognized decon format %u", format);
     return 0;
 }
 
 bool isFormatRgb(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].halFormat == format) {
-            if (exynos_format_desc[i].type & RGB)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && (desc->type & RGB);
 }
 
 bool isFormatYUV(int format)
@@ -187,106 +216,48 @@ bool isFormatYUV(int format)
 
 bool isFormatSBWC(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].halFormat == format) {
-            if (exynos_format_desc[i].type & COMP_TYPE_SBWC)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && (desc->type & COMP_TYPE_SBWC);
 }
 
 bool isFormatYUV420(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].halFormat == format) {
-            if (exynos_format_desc[i].type & YUV420)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && (desc->type & YUV420);
 }
 
 bool isFormatYUV8_2(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].halFormat == format) {
-            if ((exynos_format_desc[i].type & YUV420) &&
-                (exynos_format_desc[i].type & BIT8_2))
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && (desc->type & YUV420) && (desc->type & BIT8_2);
 }
 
 bool isFormat10BitYUV420(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].halFormat == format) {
-            if ((exynos_format_desc[i].type & YUV420) &&
-                (exynos_format_desc[i].type & BIT10))
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && (desc->type & YUV420) && (desc->type & BIT10);
 }
 
 bool isFormatYUV422(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].halFormat == format) {
-            if (exynos_format_desc[i].type & YUV422)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && (desc->type & YUV422);
 }
 
 bool isFormatP010(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].halFormat == format) {
-            if (exynos_format_desc[i].type & P010)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && (desc->type & P010);
 }
 
 bool isFormat10Bit(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if ((exynos_format_desc[i].type & BIT_MASK) == BIT10)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && ((desc->type & BIT_MASK) == BIT10);
 }
 
 bool isFormat8Bit(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if ((exynos_format_desc[i].type & BIT_MASK) == BIT8)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && ((desc->type & BIT_MASK) == BIT8);
 }
 
 bool isFormatYCrCb(int format)
@@ -296,26 +267,18 @@ bool isFormatYCrCb(int format)
 
 bool isFormatLossy(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            uint32_t sbwcType = exynos_format_desc[i].type & FORMAT_SBWC_MASK;
-            if (sbwcType && sbwcType != SBWC_LOSSLESS)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    if (desc == nullptr)
+        return false;
+
+    uint32_t sbwcType = desc->type & FORMAT_SBWC_MASK;
+    return sbwcType && sbwcType != SBWC_LOSSLESS;
 }
 
 bool formatHasAlphaChannel(int format)
 {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            return exynos_format_desc[i].hasAlpha;
-        }
-    }
-    return false;
+    auto desc = findHalFormat(format);
+    return (desc != nullptr) && desc->hasAlpha;
 }
 
 bool isAFBCCompressed(const buffer_handle_t handle) {
@@ -427,11 +390,8 @@ enum decon_pixel_format halFormatToDpuFormat(int format, uint32_t compressType)
 }
 
 uint32_t DpuFormatToHalFormat(int format, uint32_t /*compressType*/) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++){
-        if (exynos_format_desc[i].s3cFormat == static_cast<decon_pixel_format>(format))
-            return exynos_format_desc[i].halFormat;
-    }
-    return HAL_PIXEL_FORMAT_EXYNOS_UNDEFINED;
+    auto desc = findDpuFormat(static_cast<decon_pixel_format>(format));
+    return (desc != nullptr) ? desc->halFormat : HAL_PIXEL_FORMAT_EXYNOS_UNDEFINED;
 }
 
 int halFormatToDrmFormat(int format, uint32_t compressType)
@@ -928,12 +888,46 @@ void setFenceInfo(uint32_t fd, const ExynosDisplay *display, HwcFdebugFenceType
                                           dupFrom);
 }
 
+/* Fence traces are stamped with the monotonic clock, shown in local time */
+static String8 getFenceTimeStr(int64_t monotonicTime) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t wallTime = seconds_to_nanoseconds(tv.tv_sec) + microseconds_to_nanoseconds(tv.tv_usec) -
+            (systemTime(SYSTEM_TIME_MONOTONIC) - monotonicTime);
+    tv.tv_sec = wallTime / 1000000000;
+    tv.tv_usec = (wallTime % 1000000000) / 1000;
+    return getLocalTimeStr(tv);
+}
+
+FenceTracker::FenceTracker() {
+    for (uint32_t i = 0; i < kShards; i++) {
+        mShards[i].index = i;
+    }
+}
+
+HwcFenceInfo *FenceTracker::Shard::find(uint32_t fd, bool create) {
+    if (fd < kTableSize) return &infos[fd / kShards];
+
+    auto it = overflow.find(fd);
+    if (it != overflow.end()) return &it->second;
+    return create ? &overflow[fd] : nullptr;
+}
+
+void FenceTracker::Shard::erase(uint32_t fd) {
+    if (fd < kTableSize)
+        infos[fd / kShards] = HwcFenceInfo();
+    else
+        overflow.erase(fd);
+}
+
 void FenceTracker::updateFenceInfo(uint32_t fd, const ExynosDisplay *display,
                                    HwcFdebugFenceType type, HwcFdebugIpType ip,
                                    HwcFenceDirection direction, bool pendingAllowed,
                                    int32_t dupFrom) {
-    std::scoped_lock lock(mFenceMutex);
-    HwcFenceInfo &info = mFenceInfos[fd];
+    Shard &shard = mShards[fd % kShards];
+    std::scoped_lock lock(shard.mutex);
+    HwcFenceInfo &info = *shard.find(fd, true);
+    const bool tracked = (info.usage != 0);
     info.displayId = display->mDisplayId;
 
     if (info.leaking) {
@@ -963,18 +957,20 @@ void FenceTracker::updateFenceInfo(uint32_t fd, const ExynosDisplay *display,
     }
 
     if (info.usage == 0) {
-        mFenceInfos.erase(fd);
+        shard.erase(fd);
+        if (tracked) mFenceCount--;
         return;
     } else if (info.usage < 0) {
         ALOGE("%s : Invalid negative usage (%d) for Fence FD:%d", __func__, info.usage, fd);
-        printLastFenceInfoLocked(fd);
+        printFenceInfo(fd, info);
     }
 
-    HwcFenceTrace trace = {.direction = direction, .type = type, .ip = ip, .time = {0, 0}};
-
-    gettimeofday(&trace.time, NULL);
+    if (!tracked) mFenceCount++;
 
-    info.traces.push_back(trace);
+    info.addTrace({.direction = direction,
+                   .type = type,
+                   .ip = ip,
+                   .time = systemTime(SYSTEM_TIME_MONOTONIC)});
 
     FT_LOGW("FD : %d, direction : %d, type : %d, ip : %d", fd, direction, type, ip);
 
@@ -983,46 +979,50 @@ void FenceTracker::updateFenceInfo(uint32_t fd, const ExynosDisplay *display,
     info.pendingAllowed = pendingAllowed;
 }
 
-void FenceTracker::printLastFenceInfoLocked(uint32_t fd) {
+void FenceTracker::printFenceInfo(uint32_t fd, const HwcFenceInfo &info) {
     if (!fence_valid(fd)) return;
 
-    auto it = mFenceInfos.find(fd);
-    if (it == mFenceInfos.end()) return;
-    HwcFenceInfo &info = it->second;
     FT_LOGD("---- Fence FD : %d, Display(%d) ----", fd, info.displayId);
     FT_LOGD("usage: %d, dupFrom: %d, pendingAllowed: %d, leaking: %d", info.usage, info.dupFrom,
             info.pendingAllowed, info.leaking);
 
-    for (const auto &trace : info.traces) {
+    info.forEachTrace([](const HwcFenceTrace &trace) {
         FT_LOGD("> dir: %d, type: %d, ip: %d, time:%s", trace.direction, trace.type, trace.ip,
-                getLocalTimeStr(trace.time).c_str());
-    }
+                getFenceTimeStr(trace.time).c_str());
+    });
 }
 
 void FenceTracker::dumpFenceInfoLocked(int32_t count) {
     FT_LOGD("Dump fence (up to %d fences) ++", count);
-    for (const auto &[fd, info] : mFenceInfos) {
-        if (info.pendingAllowed) continue;
-        if (count-- <= 0) break;
-        printLastFenceInfoLocked(fd);
+    for (auto &shard : mShards) {
+        if (count <= 0) break;
+        std::scoped_lock lock(shard.mutex);
+        shard.forEach([&](uint32_t fd, HwcFenceInfo &info) {
+            if (info.pendingAllowed || (count <= 0)) return;
+            count--;
+            printFenceInfo(fd, info);
+        });
     }
     FT_LOGD("Dump fence --");
 }
 
 void FenceTracker::printLeakFdsLocked() {
-    auto reportLeakFdsLocked = [&fenceInfos = mFenceInfos](int sign) REQUIRES(mFenceMutex) {
+    auto reportLeakFdsLocked = [this](int sign) REQUIRES(mFenceMutex) {
         String8 errString;
         errString.appendFormat("Leak Fds (%d) :\n", sign);
 
         int cnt = 0;
-        for (const auto &[fd, info] : fenceInfos) {
-            if (!info.leaking) continue;
-            if (info.usage * sign > 0) {
-                errString.appendFormat("%d,", fd);
-                if ((++cnt % 10) == 0) {
-                    errString.append("\n");
+        for (auto &shard : mShards) {
+            std::scoped_lock lock(shard.mutex);
+            shard.forEach([&](uint32_t fd, HwcFenceInfo &info) {
+                if (!info.leaking) return;
+                if (info.usage * sign > 0) {
+                    errString.appendFormat("%d,", fd);
+                    if ((++cnt % 10) == 0) {
+                        errString.append("\n");
+                    }
                 }
-            }
+            });
         }
 
         FT_LOGW("%s", errString.c_str());
@@ -1034,14 +1034,15 @@ void FenceTracker::printLeakFdsLocked() {
 
 void FenceTracker::dumpNCheckLeakLocked() {
     FT_LOGD("Dump leaking fence ++");
-    for (auto &[fd, info] : mFenceInfos) {
-        if (!info.pendingAllowed) {
+    for (auto &shard : mShards) {
+        std::scoped_lock lock(shard.mutex);
+        shard.forEach([&](uint32_t fd, HwcFenceInfo &info) {
             // leak is occurred in this frame first
-            if (!info.leaking) {
+            if (!info.pendingAllowed && !info.leaking) {
                 info.leaking = true;
-                printLastFenceInfoLocked(fd);
+                printFenceInfo(fd, info);
             }
-        }
+        });
     }
 
     int priv = exynosHWCControl.fenceTracer;
@@ -1053,7 +1054,7 @@ void FenceTracker::dumpNCheckLeakLocked() {
 }
 
 bool FenceTracker::fenceWarnLocked(uint32_t threshold) {
-    uint32_t cnt = mFenceInfos.size();
+    uint32_t cnt = mFenceCount;
 
     if (cnt > threshold) {
         ALOGE("Fence leak! -- the number of fences(%d) exceeds threshold(%d)", cnt, threshold);
@@ -1069,12 +1070,13 @@ bool FenceTracker::fenceWarnLocked(uint32_t threshold) {
 bool FenceTracker::validateFencePerFrameLocked(const ExynosDisplay *display) {
     bool ret = true;
 
-    for (const auto &[fd, info] : mFenceInfos) {
-        if (info.displayId != display->mDisplayId) continue;
-        if ((!info.pendingAllowed) && (!info.leaking)) {
-            ret = false;
-            break;
-        }
+    for (auto &shard : mShards) {
+        if (!ret) break;
+        std::scoped_lock lock(shard.mutex);
+        shard.forEach([&](uint32_t, HwcFenceInfo &info) {
+            if (info.displayId != display->mDisplayId) return;
+            if ((!info.pendingAllowed) && (!info.leaking)) ret = false;
+        });
     }
 
     if (!ret) {
@@ -1125,15 +1127,19 @@ int32_t FenceTracker::saveFenceTraceLocked(ExynosDisplay *display) {
     gettimeofday(&tv, NULL);
     saveString.appendFormat("\n====== Fences at time:%s ======\n", getLocalTimeStr(tv).c_str());
 
-    for (const auto &[fd, info] : mFenceInfos) {
-        saveString.appendFormat("---- Fence FD : %d, Display(%d) ----\n", fd, info.displayId);
-        saveString.appendFormat("usage: %d, dupFrom: %d, pendingAllowed: %d, leaking: %d\n",
-                                info.usage, info.dupFrom, info.pendingAllowed, info.leaking);
-
-        for (const auto &trace : info.traces) {
-            saveString.appendFormat("> dir: %d, type: %d, ip: %d, time:%s\n", trace.direction,
-                                    trace.type, trace.ip, getLocalTimeStr(trace.time).c_str());
-        }
+    for (auto &shard : mShards) {
+        std::scoped_lock lock(shard.mutex);
+        shard.forEach([&](uint32_t fd, HwcFenceInfo &info) {
+            saveString.appendFormat("---- Fence FD : %d, Display(%d) ----\n", fd, info.displayId);
+            saveString.appendFormat("usage: %d, dupFrom: %d, pendingAllowed: %d, leaking: %d\n",
+                                    info.usage, info.dupFrom, info.pendingAllowed, info.leaking);
+
+            info.forEachTrace([&](const HwcFenceTrace &trace) {
+                saveString.appendFormat("> dir: %d, type: %d, ip: %d, time:%s\n",
+                                        trace.direction, trace.type, trace.ip,
+                                        getFenceTimeStr(trace.time).c_str());
+            });
+        });
     }
 
     fileWriter.write(saveString);
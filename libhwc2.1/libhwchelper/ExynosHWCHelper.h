@@ -21,8 +21,13 @@
 #include <hardware/hwcomposer2.h>
 #include <utils/String8.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <fstream>
 #include <list>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -529,16 +534,28 @@ struct HwcFenceTrace {
     HwcFenceDirection direction = HwcFenceDirection::FROM;
     HwcFdebugFenceType type = FENCE_TYPE_UNDEFINED;
     HwcFdebugIpType ip = FENCE_IP_UNDEFINED;
-    struct timeval time = {0, 0};
+    int64_t time = 0; /* CLOCK_MONOTONIC, in ns */
 };
 
 struct HwcFenceInfo {
+    static constexpr uint32_t kTraceSize = 8;
+
     uint32_t displayId = HWC_DISPLAY_PRIMARY;
     int32_t usage = 0;
     int32_t dupFrom = -1;
     bool pendingAllowed = false;
     bool leaking = false;
-    std::list<HwcFenceTrace> traces = {};
+    /* Ring of the latest kTraceSize transitions, traceCount counts all of them */
+    std::array<HwcFenceTrace, kTraceSize> traces = {};
+    uint32_t traceCount = 0;
+
+    void addTrace(const HwcFenceTrace &trace) { traces[traceCount++ % kTraceSize] = trace; }
+
+    template <typename Func>
+    void forEachTrace(Func func) const {
+        uint32_t first = (traceCount > kTraceSize) ? (traceCount - kTraceSize) : 0;
+        for (uint32_t i = first; i < traceCount; i++) func(traces[i % kTraceSize]);
+    }
 };
 
 class funcReturnCallback {
@@ -559,13 +576,41 @@ void setFenceInfo(uint32_t fd, const ExynosDisplay *display, HwcFdebugFenceType
 
 class FenceTracker {
 public:
+    FenceTracker();
     void updateFenceInfo(uint32_t fd, const ExynosDisplay *display, HwcFdebugFenceType type,
                          HwcFdebugIpType ip, HwcFenceDirection direction,
                          bool pendingAllowed = false, int32_t dupFrom = -1);
     bool validateFences(ExynosDisplay *display);
 
 private:
-    void printLastFenceInfoLocked(uint32_t fd) REQUIRES(mFenceMutex);
+    /*
+     * Fence fds are spread over kShards locks so that threads updating
+     * different fences rarely contend. Fds below kTableSize are kept in a flat
+     * table, the rest in a per-shard map.
+     */
+    static constexpr uint32_t kShards = 16;
+    static constexpr uint32_t kTableSize = 1024;
+
+    struct Shard {
+        HwcFenceInfo *find(uint32_t fd, bool create) REQUIRES(mutex);
+        void erase(uint32_t fd) REQUIRES(mutex);
+
+        /* Calls func(fd, info) for every tracked fence of the shard */
+        template <typename Func>
+        void forEach(Func func) REQUIRES(mutex) {
+            for (uint32_t i = 0; i < infos.size(); i++) {
+                if (infos[i].usage != 0) func(i * kShards + index, infos[i]);
+            }
+            for (auto &[fd, info] : overflow) func(fd, info);
+        }
+
+        uint32_t index = 0;
+        std::mutex mutex;
+        std::array<HwcFenceInfo, kTableSize / kShards> infos GUARDED_BY(mutex);
+        std::map<uint32_t, HwcFenceInfo> overflow GUARDED_BY(mutex);
+    };
+
+    void printFenceInfo(uint32_t fd, const HwcFenceInfo &info);
     void dumpFenceInfoLocked(int32_t count) REQUIRES(mFenceMutex);
     void printLeakFdsLocked() REQUIRES(mFenceMutex);
     void dumpNCheckLeakLocked() REQUIRES(mFenceMutex);
@@ -573,7 +618,9 @@ private:
     bool validateFencePerFrameLocked(const ExynosDisplay *display) REQUIRES(mFenceMutex);
     int32_t saveFenceTraceLocked(ExynosDisplay *display) REQUIRES(mFenceMutex);
 
-    std::map<int, HwcFenceInfo> mFenceInfos GUARDED_BY(mFenceMutex);
+    std::array<Shard, kShards> mShards;
+    std::atomic<uint32_t> mFenceCount = 0;
+    /* Serializes the walks over all shards */
     mutable std::mutex mFenceMutex;
 };
 
@@ -673,6 +720,28 @@ struct RollingAverage {
     }
 };
 
+// Keeps the last bufferSize samples to report tail values such as p99
+template <size_t bufferSize>
+struct RollingPercentile {
+    std::array<int64_t, bufferSize> buffer{0};
+    size_t elems = 0;
+    size_t buffer_index = 0;
+    void insert(int64_t sample) {
+        buffer[buffer_index] = sample;
+        buffer_index = (buffer_index + 1) % bufferSize;
+        elems = std::min(elems + 1, bufferSize);
+    }
+    // nearest-rank percentile, 0 if there is no sample yet
+    int64_t percentile(uint32_t p) const {
+        if (elems == 0) return 0;
+        std::array<int64_t, bufferSize> sorted = buffer;
+        size_t rank = (elems * std::min(p, 100u) + 99) / 100;
+        rank = (rank > 0) ? rank - 1 : 0;
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + elems);
+        return sorted[rank];
+    }
+};
+
 // Waits for a given property value, or returns std::nullopt if unavailable
 std::optional<std::string> waitForPropertyValue(const std::string &property, int64_t timeoutMs);
 
@@ -476,29 +476,12 @@ bool ExynosMPP::isSrcFormatSupported(struct exynos_image &src)
 
     if (mResourceManager == NULL) return false;
 
-    for (uint32_t i = 0 ; i < mResourceManager->mFormatRestrictionCnt; i++) {
-        if ((mResourceManager->mFormatRestrictions[i].hwType == mPhysicalType) &&
-                ((mResourceManager->mFormatRestrictions[i].nodeType == NODE_NONE) ||
-                 (mResourceManager->mFormatRestrictions[i].nodeType == NODE_SRC)) &&
-                (mResourceManager->mFormatRestrictions[i].format == src.format))
-            return true;
-    }
-
-    return false;
+    return mSrcFormats.count(src.format) != 0;
 }
 
 bool ExynosMPP::isDstFormatSupported(struct exynos_image &dst)
 {
-
-    for (uint32_t i = 0 ; i < mResourceManager->mFormatRestrictionCnt; i++) {
-        if ((mResourceManager->mFormatRestrictions[i].hwType == mPhysicalType) &&
-                ((mResourceManager->mFormatRestrictions[i].nodeType == NODE_NONE) ||
-                 (mResourceManager->mFormatRestrictions[i].nodeType == NODE_DST)) &&
-                (mResourceManager->mFormatRestrictions[i].format == dst.format))
-            return true;
-    }
-
-    return false;
+    return mDstFormats.count(dst.format) != 0;
 }
 
 uint32_t ExynosMPP::getMaxUpscale(const struct exynos_image &src,
@@ -2002,6 +1985,20 @@ int32_t ExynosMPP::setupRestriction() {
 
     MPP_LOGD(eDebugMPP, "mPhysicalType(%d)", mPhysicalType);
 
+    mSrcFormats.clear();
+    mDstFormats.clear();
+    for (uint32_t i = 0; i < mResourceManager->mFormatRestrictionCnt; i++) {
+        const restriction_key_t &key = mResourceManager->mFormatRestrictions[i];
+        if (key.hwType != mPhysicalType)
+            continue;
+        if ((key.nodeType == NODE_NONE) || (key.nodeType == NODE_SRC))
+            mSrcFormats.insert(key.format);
+        if ((key.nodeType == NODE_NONE) || (key.nodeType == NODE_DST))
+            mDstFormats.insert(key.format);
+    }
+    MPP_LOGD(eDebugMPP, "\t%zu src formats, %zu dst formats", mSrcFormats.size(),
+            mDstFormats.size());
+
     for (uint32_t i = 0; i < RESTRICTION_MAX; i++) {
         const restriction_size_element *restriction_size_table = mResourceManager->mSizeRestrictions[i];
         for (uint32_t j = 0; j < mResourceManager->mSizeRestrictionCnt[i]; j++) {
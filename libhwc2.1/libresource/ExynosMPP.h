@@ -31,6 +31,7 @@
 #include <map>
 #include <hardware/exynos/acryl.h>
 #include <map>
+#include <unordered_set>
 #include "ExynosHWCModule.h"
 #include "ExynosHWCHelper.h"
 #include "ExynosMPPType.h"
@@ -754,6 +755,10 @@ protected:
 
     uint32_t mClockKhz = 0;
     float mPPC = 0;
+
+    /* HAL formats of mResourceManager->mFormatRestrictions for this MPP, set by setupRestriction() */
+    std::unordered_set<uint32_t> mSrcFormats;
+    std::unordered_set<uint32_t> mDstFormats;
 };
 
 #endif //_EXYNOSMPP_H
@@ -23,6 +23,7 @@
 
 #include <cutils/properties.h>
 
+#include <functional>
 #include <numeric>
 #include <unordered_set>
 
@@ -46,6 +47,11 @@ ExynosMPPVector ExynosResourceManager::mOtfMPPs;
 ExynosMPPVector ExynosResourceManager::mM2mMPPs;
 extern struct exynos_hwc_control exynosHWCControl;
 
+template <typename T>
+static inline void hashCombine(size_t &seed, const T &value) {
+    seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
 ExynosMPPVector::ExynosMPPVector() {
 }
 
@@ -161,6 +167,7 @@ ExynosResourceManager::ExynosResourceManager(ExynosDevice *device)
     char value[PROPERTY_VALUE_MAX];
     mMinimumSdrDimRatio = property_get("debug.hwc.min_sdr_dimming", value, nullptr) > 0
                           ? std::atof(value) : 0.0f;
+    mIncrementalAssignEnabled = property_get_bool("debug.hwc.incremental_assign", true);
     updateSupportWCG();
 }
 
@@ -427,10 +434,16 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display)
         return ret;
     }
 
-    if ((ret = assignResourceInternal(display)) != NO_ERROR) {
-        HWC_LOGE(display, "%s:: assignResourceInternal() error (%d)",
-                __func__, ret);
-        return ret;
+    if (assignResourceIncremental(display)) {
+        mIncrementalAssignCount++;
+    } else {
+        mAssignSnapshots.erase(display->mDisplayId);
+        if ((ret = assignResourceInternal(display)) != NO_ERROR) {
+            HWC_LOGE(display, "%s:: assignResourceInternal() error (%d)",
+                    __func__, ret);
+            return ret;
+        }
+        mFullAssignCount++;
     }
 
     if ((ret = assignWindow(display)) != NO_ERROR) {
@@ -438,6 +451,7 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display)
                 __func__, ret);
         return ret;
     }
+    saveAssignSnapshot(display);
 
     if (hwcCheckDebugMessages(eDebugResourceManager)) {
         HDEBUGLOGD(eDebugResourceManager, "AssignResource result");
@@ -572,6 +586,35 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display)
         }
     }
 
+    /*
+     * Add layers that can't be assigned to any MPP regardless of
+     * the MPP state, so that the client composition range is known
+     * before the first try and doesn't have to be discovered by retries.
+     * Low fps layer handling is done by assignLayers() itself.
+     */
+    if (display->mLowFpsLayerInfo.mHasLowFpsLayer == false) {
+        for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+            ExynosLayer *layer = display->mLayers[i];
+            if ((layer->mValidateCompositionType == HWC2_COMPOSITION_CLIENT) ||
+                (layer->mCompositionType == HWC2_COMPOSITION_DISPLAY_DECORATION))
+                continue;
+            uint32_t validateFlag = validateLayer(i, display, layer);
+            if ((validateFlag == NO_ERROR) || (validateFlag == eDimLayer) ||
+                (validateFlag == eLowFpsLayer))
+                continue;
+            HDEBUGLOGD(eDebugResourceAssigning, "\t[%d] layer is always client (0x%8x)", i,
+                       validateFlag);
+            layer->mOverlayInfo |= validateFlag;
+            layer->mValidateCompositionType = HWC2_COMPOSITION_CLIENT;
+            if (((ret = display->addClientCompositionLayer(i)) != NO_ERROR) &&
+                (ret != EXYNOS_ERROR_CHANGED)) {
+                HWC_LOGE(display, "%s:: addClientCompositionLayer failed (%d)", __func__, ret);
+                return ret;
+            }
+        }
+        ret = NO_ERROR;
+    }
+
     do {
         HDEBUGLOGD(eDebugResourceAssigning, "%s:: retry_count(%d)", __func__, retry_count);
         if ((ret = resetAssignedResources(display)) != NO_ERROR)
@@ -645,6 +688,9 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display)
         retry_count++;
     } while((ret == EXYNOS_ERROR_CHANGED) && (retry_count < ASSIGN_RESOURCE_TRY_COUNT));
 
+    mLastAssignRetryCount = retry_count;
+    mMaxAssignRetryCount = std::max(mMaxAssignRetryCount, (uint32_t)retry_count);
+
     if (retry_count == ASSIGN_RESOURCE_TRY_COUNT) {
         HWC_LOGE(display, "%s:: assign resources fail", __func__);
         ret = eUnknown;
@@ -669,6 +715,223 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display)
     return ret;
 }
 
+size_t ExynosResourceManager::getAssignContextKey(ExynosDisplay *display) const
+{
+    /* Display and device states that are checked by validateLayer() and assignLayer() */
+    size_t key = 0;
+    hashCombine(key, exynosHWCControl.forceGpu);
+    hashCombine(key, mResourceReserved);
+    hashCombine(key, mDevice->mDisplayMode);
+    hashCombine(key, display->mUseDpu);
+    hashCombine(key, display->mMaxWindowNum);
+    hashCombine(key, display->mBaseWindowIndex);
+    hashCombine(key, display->mXres);
+    hashCombine(key, display->mYres);
+    hashCombine(key, display->mDREnable);
+    hashCombine(key, static_cast<int32_t>(display->mDynamicReCompMode));
+    hashCombine(key, display->mColorTransformHint);
+    hashCombine(key, static_cast<int32_t>(display->mColorMode));
+    return key;
+}
+
+size_t ExynosResourceManager::getAssignSignature(ExynosLayer *layer)
+{
+    exynos_image src_img;
+    exynos_image dst_img;
+    layer->setSrcExynosImage(&src_img);
+    layer->setDstExynosImage(&dst_img);
+
+    /* Buffer handles and fences change every frame and don't affect assignment */
+    size_t signature = 0;
+    for (const exynos_image *img : {&src_img, &dst_img}) {
+        hashCombine(signature, img->fullWidth);
+        hashCombine(signature, img->fullHeight);
+        hashCombine(signature, img->x);
+        hashCombine(signature, img->y);
+        hashCombine(signature, img->w);
+        hashCombine(signature, img->h);
+        hashCombine(signature, img->format);
+        hashCombine(signature, img->usageFlags);
+        hashCombine(signature, img->layerFlags);
+        hashCombine(signature, img->bufferHandle != NULL);
+        hashCombine(signature, static_cast<int32_t>(img->dataSpace));
+        hashCombine(signature, img->blending);
+        hashCombine(signature, img->transform);
+        hashCombine(signature, img->compressionInfo.type);
+        hashCombine(signature, img->compressionInfo.modifier);
+        hashCombine(signature, img->planeAlpha);
+        hashCombine(signature, img->zOrder);
+        hashCombine(signature, img->hasMetaParcel);
+        hashCombine(signature, static_cast<int32_t>(img->metaType));
+        hashCombine(signature, img->needColorTransform);
+        hashCombine(signature, img->needPreblending);
+    }
+    hashCombine(signature, layer->mCompositionType);
+    hashCombine(signature, layer->mOverlayPriority);
+    hashCombine(signature, layer->mSupportedMPPFlag);
+    hashCombine(signature, layer->mPreprocessedInfo.sdrDimRatio);
+    hashCombine(signature, isSrcCropFloat(layer->mPreprocessedInfo.sourceCrop));
+    hashCombine(signature, layer->mPreprocessedInfo.displayFrame.left);
+    hashCombine(signature, layer->mPreprocessedInfo.displayFrame.top);
+    hashCombine(signature, layer->mPreprocessedInfo.displayFrame.right);
+    hashCombine(signature, layer->mPreprocessedInfo.displayFrame.bottom);
+    return signature;
+}
+
+void ExynosResourceManager::saveAssignSnapshot(ExynosDisplay *display)
+{
+    mAssignSnapshots.erase(display->mDisplayId);
+
+    /*
+     * M2M capacity and low fps layer handling depend on other layers and
+     * other displays, so such results are always assigned from scratch.
+     */
+    if (!mIncrementalAssignEnabled || !display->mUseDpu ||
+        display->mExynosCompositionInfo.mHasCompositionLayer ||
+        display->mLowFpsLayerInfo.mHasLowFpsLayer)
+        return;
+
+    AssignSnapshot snapshot;
+    snapshot.contextKey = getAssignContextKey(display);
+    snapshot.layers.reserve(display->mLayers.size());
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        if (layer->mM2mMPP != NULL)
+            return;
+        if ((layer->mValidateCompositionType == HWC2_COMPOSITION_DEVICE) &&
+            (layer->mOtfMPP == NULL))
+            return;
+        snapshot.layers.push_back({layer, getAssignSignature(layer),
+                                   layer->mValidateCompositionType, layer->mOverlayInfo,
+                                   layer->mOtfMPP});
+    }
+    snapshot.hasClientComposition = display->mClientCompositionInfo.mHasCompositionLayer;
+    snapshot.clientFirstIndex = display->mClientCompositionInfo.mFirstIndex;
+    snapshot.clientLastIndex = display->mClientCompositionInfo.mLastIndex;
+    mAssignSnapshots[display->mDisplayId] = std::move(snapshot);
+}
+
+/**
+ * Replays the previous assignment of the display and re-validates only the
+ * layers whose assignment signature changed.
+ * @return true if the assignment is done, false if full assignment is needed
+ */
+bool ExynosResourceManager::assignResourceIncremental(ExynosDisplay *display)
+{
+    auto it = mAssignSnapshots.find(display->mDisplayId);
+    if (!mIncrementalAssignEnabled || (it == mAssignSnapshots.end()))
+        return false;
+    const AssignSnapshot &snapshot = it->second;
+
+    /*
+     * Display or device level changes can affect every layer.
+     * Low fps layers of this frame are grouped by assignResourceInternal().
+     */
+    if ((mDevice->mGeometryChanged & ~GEOMETRY_LAYER_CHANGED_MASK) ||
+        display->mLowFpsLayerInfo.mHasLowFpsLayer ||
+        (snapshot.layers.size() != display->mLayers.size()) ||
+        (snapshot.contextKey != getAssignContextKey(display)))
+        return false;
+
+    Mutex::Autolock lock(mDstBufMgrThread->mStateMutex);
+    if (mForceReallocState != DST_REALLOC_DONE)
+        return false;
+
+    std::vector<bool> dirty(display->mLayers.size(), false);
+    uint32_t dirtyNum = 0;
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        const AssignSnapshot::LayerEntry &entry = snapshot.layers[i];
+        if (entry.layer != layer)
+            return false;
+        if ((layer->mGeometryChanged == 0) || (getAssignSignature(layer) == entry.signature))
+            continue;
+
+        /*
+         * A changed layer can keep its placement if it stays on the same otfMPP,
+         * or if it is a client layer whose removal can't shrink the client
+         * composition range.
+         */
+        bool keepable = false;
+        if (entry.compositionType == HWC2_COMPOSITION_DEVICE) {
+            keepable = (entry.otfMPP != NULL);
+        } else if (entry.compositionType == HWC2_COMPOSITION_CLIENT) {
+            keepable = (layer->mCompositionType == HWC2_COMPOSITION_CLIENT) ||
+                    (((int32_t)i > snapshot.clientFirstIndex) &&
+                     ((int32_t)i < snapshot.clientLastIndex) &&
+                     !layer->needClearClientTarget());
+        } else if (entry.compositionType == HWC2_COMPOSITION_DISPLAY_DECORATION) {
+            keepable = true;
+        }
+        if (!keepable) {
+            HDEBUGLOGD(eDebugResourceManager, "%s:: [%d] layer needs full assignment",
+                       __func__, i);
+            return false;
+        }
+        dirty[i] = true;
+        dirtyNum++;
+    }
+
+    HDEBUGLOGD(eDebugResourceManager, "%s:: replay previous assignment, changed layers(%d)",
+               __func__, dirtyNum);
+
+    auto rollback = [&]() {
+        resetAssignedResources(display);
+        for (uint32_t i = 0; i < display->mLayers.size(); i++)
+            display->mLayers[i]->resetValidateData();
+        display->initializeValidateInfos();
+        return false;
+    };
+
+    if (resetAssignedResources(display) != NO_ERROR)
+        return rollback();
+
+    if (snapshot.hasClientComposition) {
+        display->mClientCompositionInfo.mHasCompositionLayer = true;
+        display->mClientCompositionInfo.mFirstIndex = snapshot.clientFirstIndex;
+        display->mClientCompositionInfo.mLastIndex = snapshot.clientLastIndex;
+        if (assignCompositionTarget(display, COMPOSITION_CLIENT) != NO_ERROR)
+            return rollback();
+    }
+
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        const AssignSnapshot::LayerEntry &entry = snapshot.layers[i];
+
+        exynos_image src_img;
+        exynos_image dst_img;
+        layer->setSrcExynosImage(&src_img);
+        layer->setDstExynosImage(&dst_img);
+        layer->setExynosImage(src_img, dst_img);
+        layer->setExynosMidImage(dst_img);
+
+        if (entry.compositionType == HWC2_COMPOSITION_DEVICE) {
+            ExynosMPP *otfMPP = entry.otfMPP;
+            if (dirty[i] &&
+                ((validateLayer(i, display, layer) != NO_ERROR) ||
+                 ((layer->mSupportedMPPFlag & otfMPP->mLogicalType) == 0) ||
+                 (otfMPP->isSupported(*display, src_img, dst_img) != NO_ERROR)))
+                return rollback();
+            if ((display->mWindowNumUsed >= display->mMaxWindowNum) ||
+                !isAssignable(otfMPP, display, src_img, dst_img, layer) ||
+                (otfMPP->assignMPP(display, layer) != NO_ERROR))
+                return rollback();
+            display->mWindowNumUsed++;
+        } else if ((entry.compositionType == HWC2_COMPOSITION_DISPLAY_DECORATION) && dirty[i]) {
+            if (validateRCDLayer(*display, *layer, i, src_img, dst_img) != NO_ERROR)
+                return rollback();
+        }
+        layer->mValidateCompositionType = entry.compositionType;
+        layer->mOverlayInfo = entry.overlayInfo;
+    }
+
+    /* Same as the end of a successful try in assignResourceInternal() */
+    if (setResourcePriority(display) != NO_ERROR)
+        return rollback();
+
+    return true;
+}
+
 int32_t ExynosResourceManager::updateExynosComposition(ExynosDisplay *display)
 {
     int ret = NO_ERROR;
@@ -2711,6 +2974,11 @@ void ExynosResourceManager::dump(String8 &result) const {
     result.appendFormat("[YUV Restrictions]\n");
     dump(RESTRICTION_YUV, result);
 
+    result.appendFormat("[Assignment] incremental: %" PRIu64 ", full: %" PRIu64
+                        ", tries(last: %u, max: %u)\n",
+                        mIncrementalAssignCount, mFullAssignCount, mLastAssignRetryCount,
+                        mMaxAssignRetryCount);
+
     result.appendFormat("[MPP Dump]\n");
     for (auto mpp : mOtfMPPs) {
         mpp->dump(result);
@@ -123,6 +123,7 @@ class ExynosResourceManager {
         int32_t doAllocDstBufs(uint32_t mXres, uint32_t mYres);
         int32_t assignResource(ExynosDisplay *display);
         int32_t assignResourceInternal(ExynosDisplay *display);
+        bool assignResourceIncremental(ExynosDisplay *display);
         static ExynosMPP* getExynosMPP(uint32_t type);
         static ExynosMPP* getExynosMPP(uint32_t physicalType, uint32_t physicalIndex);
         static void enableMPP(uint32_t physicalType, uint32_t physicalIndex, uint32_t logicalIndex, uint32_t enable);
@@ -192,9 +193,38 @@ class ExynosResourceManager {
                                               uint32_t layer_index, const exynos_image& m2m_out_img,
                                               ExynosMPP* m2mMPP, ExynosMPP* otfMPP);
         void dump(const restriction_classification_t, String8 &result) const;
+        size_t getAssignContextKey(ExynosDisplay *display) const;
+        static size_t getAssignSignature(ExynosLayer *layer);
+        void saveAssignSnapshot(ExynosDisplay *display);
 
         sp<DstBufMgrThread> mDstBufMgrThread;
 
+        /*
+         * Result of the last full resource assignment of a display.
+         * It is replayed by assignResourceIncremental() when only some layers
+         * have changed and every changed layer can keep its previous placement.
+         */
+        struct AssignSnapshot {
+            struct LayerEntry {
+                ExynosLayer *layer;
+                size_t signature;
+                int32_t compositionType;
+                uint32_t overlayInfo;
+                ExynosMPP *otfMPP;
+            };
+            size_t contextKey = 0;
+            std::vector<LayerEntry> layers;
+            bool hasClientComposition = false;
+            int32_t clientFirstIndex = -1;
+            int32_t clientLastIndex = -1;
+        };
+        std::map<uint32_t, AssignSnapshot> mAssignSnapshots;
+        bool mIncrementalAssignEnabled;
+        uint64_t mIncrementalAssignCount = 0;
+        uint64_t mFullAssignCount = 0;
+        uint32_t mLastAssignRetryCount = 0;
+        uint32_t mMaxAssignRetryCount = 0;
+
     protected:
         virtual void setFrameRateForPerformance(ExynosMPP &mpp, AcrylicPerformanceRequestFrame *frame);
         void getCandidateScalingM2mMPPOutImages(const ExynosDisplay *display,
@@ -16,14 +16,20 @@
 
 #pragma once
 
-#include <queue>
+#include <map>
+#include <unordered_map>
 
 #include "interface/Event.h"
 
 namespace android::hardware::graphics::composer {
 
+// Events are kept ordered by their due time, and additionally indexed by event type so that
+// cancelling or counting the events of one type doesn't have to walk the whole queue. The index
+// of a type is ordered the same way as the queue, so an event is found in it by its due time.
 struct EventQueue {
 public:
+    using EventMap = std::multimap<int64_t, VrrControllerEvent>;
+
     EventQueue() = default;
 
     void postEvent(VrrControllerEventType type, TimedEvent& timedEvent) {
@@ -32,46 +38,94 @@ public:
         setTimedEventWithAbsoluteTime(timedEvent);
         event.mWhenNs = timedEvent.mWhenNs;
         event.mFunctor = std::move(timedEvent.mFunctor);
-        mPriorityQueue.emplace(event);
+        postEvent(std::move(event));
     }
 
     void postEvent(VrrControllerEventType type, int64_t when) {
         VrrControllerEvent event;
         event.mEventType = type;
         event.mWhenNs = when;
-        mPriorityQueue.emplace(event);
+        postEvent(std::move(event));
+    }
+
+    void postEvent(VrrControllerEvent event) {
+        auto type = event.mEventType;
+        auto when = event.mWhenNs;
+        auto it = mEvents.emplace(when, std::move(event));
+        mEventsByType[type].emplace(when, it);
     }
 
-    void dropEvent() { mPriorityQueue = std::priority_queue<VrrControllerEvent>(); }
+    bool empty() const { return mEvents.empty(); }
+
+    size_t size() const { return mEvents.size(); }
+
+    // The earliest event. The queue must not be empty.
+    const VrrControllerEvent& top() const { return mEvents.begin()->second; }
 
-    void dropEvent(VrrControllerEventType event_type) {
-        std::priority_queue<VrrControllerEvent> q;
-        while (!mPriorityQueue.empty()) {
-            const auto& it = mPriorityQueue.top();
-            if (it.mEventType != event_type) {
-                q.push(it);
+    void pop() { erase(mEvents.begin()); }
+
+    void dropEvent() {
+        mEvents.clear();
+        mEventsByType.clear();
+    }
+
+    // Drops all events of exactly |eventType|.
+    void dropEvent(VrrControllerEventType eventType) {
+        auto bucket = mEventsByType.find(eventType);
+        if (bucket == mEventsByType.end()) {
+            return;
+        }
+        for (const auto& [whenNs, it] : bucket->second) {
+            mEvents.erase(it);
+        }
+        mEventsByType.erase(bucket);
+    }
+
+    // Drops all events whose type contains every bit of |mask|.
+    void dropEventByMask(VrrControllerEventType mask) {
+        auto target = static_cast<int>(mask);
+        for (auto bucket = mEventsByType.begin(); bucket != mEventsByType.end();) {
+            if ((static_cast<int>(bucket->first) & target) != target) {
+                ++bucket;
+                continue;
+            }
+            for (const auto& [whenNs, it] : bucket->second) {
+                mEvents.erase(it);
             }
-            mPriorityQueue.pop();
+            bucket = mEventsByType.erase(bucket);
         }
-        mPriorityQueue = std::move(q);
     }
 
-    size_t getNumberOfEvents(VrrControllerEventType eventType) {
-        size_t res = 0;
-        std::priority_queue<VrrControllerEvent> q;
-        while (!mPriorityQueue.empty()) {
-            const auto& it = mPriorityQueue.top();
-            if (it.mEventType == eventType) {
-                ++res;
+    size_t getNumberOfEvents(VrrControllerEventType eventType) const {
+        auto bucket = mEventsByType.find(eventType);
+        return (bucket == mEventsByType.end()) ? 0 : bucket->second.size();
+    }
+
+    // Events in the order they are due.
+    const EventMap& events() const { return mEvents; }
+
+private:
+    void erase(EventMap::iterator it) {
+        auto bucket = mEventsByType.find(it->second.mEventType);
+        if (bucket != mEventsByType.end()) {
+            auto& index = bucket->second;
+            auto [first, last] = index.equal_range(it->first);
+            for (auto pos = first; pos != last; ++pos) {
+                if (pos->second == it) {
+                    index.erase(pos);
+                    break;
+                }
+            }
+            if (index.empty()) {
+                mEventsByType.erase(bucket);
             }
-            q.push(it);
-            mPriorityQueue.pop();
         }
-        mPriorityQueue = std::move(q);
-        return res;
+        mEvents.erase(it);
     }
 
-    std::priority_queue<VrrControllerEvent> mPriorityQueue;
+    EventMap mEvents;
+    std::unordered_map<VrrControllerEventType, std::multimap<int64_t, EventMap::iterator>>
+            mEventsByType;
 };
 
 } // namespace android::hardware::graphics::composer
@@ -48,7 +48,7 @@ public:
                 mEventQueue->dropEvent(VrrControllerEventType::kAodRefreshRateCalculatorUpdate);
                 mResetRefreshRateEvent.mWhenNs =
                         getSteadyClockTimeNs() + kActiveRefreshRateDurationNs;
-                mEventQueue->mPriorityQueue.emplace(mResetRefreshRateEvent);
+                mEventQueue->postEvent(mResetRefreshRateEvent);
                 if (mAodRefreshRateState == kAodIdleRefreshRateState) {
                     changeRefreshRateDisplayState();
                 }
@@ -109,7 +109,7 @@ private:
             mAodRefreshRateState = kAodActiveToIdleTransitionState;
             mResetRefreshRateEvent.mWhenNs =
                     getSteadyClockTimeNs() + kActiveToIdleTransitionDurationNs;
-            mEventQueue->mPriorityQueue.emplace(mResetRefreshRateEvent);
+            mEventQueue->postEvent(mResetRefreshRateEvent);
         } else {
             mAodRefreshRateState = kAodIdleRefreshRateState;
         }
@@ -82,7 +82,7 @@ void PeriodRefreshRateCalculator::setEnabled(bool isEnabled) {
         mMeasureEvent.mWhenNs = mLastMeasureTimeNs;
         mMeasureEvent.mFunctor =
                 std::move(std::bind(&PeriodRefreshRateCalculator::onMeasure, this));
-        mEventQueue->mPriorityQueue.emplace(mMeasureEvent);
+        mEventQueue->postEvent(mMeasureEvent);
     }
 }
 
@@ -124,7 +124,7 @@ int PeriodRefreshRateCalculator::onMeasure() {
     // Prepare next measurement event.
     mLastMeasureTimeNs += mParams.mMeasurePeriodNs;
     mMeasureEvent.mWhenNs = mLastMeasureTimeNs;
-    mEventQueue->mPriorityQueue.emplace(mMeasureEvent);
+    mEventQueue->postEvent(mMeasureEvent);
     return NO_ERROR;
 }
 
@@ -42,7 +42,7 @@ VariableRefreshRateStatistic::VariableRefreshRateStatistic(
     mUpdateEvent.mFunctor =
             std::move(std::bind(&VariableRefreshRateStatistic::updateStatistic, this));
     mUpdateEvent.mWhenNs = getSteadyClockTimeNs() + mUpdatePeriodNs;
-    mEventQueue->mPriorityQueue.emplace(mUpdateEvent);
+    mEventQueue->postEvent(mUpdateEvent);
 #endif
     mStatistics[mDisplayPresentProfile] = DisplayPresentRecord();
 }
@@ -274,7 +274,7 @@ int VariableRefreshRateStatistic::updateStatistic() {
     }
     // Post next update statistics event.
     mUpdateEvent.mWhenNs = getSteadyClockTimeNs() + mUpdatePeriodNs;
-    mEventQueue->mPriorityQueue.emplace(mUpdateEvent);
+    mEventQueue->postEvent(mUpdateEvent);
 
     return NO_ERROR;
 }
@@ -233,7 +233,7 @@ void VariableRefreshRateController::reset() {
     ATRACE_CALL();
 
     const std::lock_guard<std::mutex> lock(mMutex);
-    mEventQueue.mPriorityQueue = std::priority_queue<VrrControllerEvent>();
+    mEventQueue.dropEvent();
     mRecord.clear();
     dropEventLocked();
     if (mLastPresentFence.has_value()) {
@@ -381,7 +381,7 @@ void VariableRefreshRateController::postSetPowerMode(int32_t powerMode) {
                 // We should transition from either HWC_POWER_MODE_OFF, HWC_POWER_MODE_DOZE, or
                 // HWC_POWER_MODE_DOZE_SUSPEND. At this point, there should be no pending events
                 // posted.
-                if (!mEventQueue.mPriorityQueue.empty()) {
+                if (!mEventQueue.empty()) {
                     LOG(WARNING) << "VrrController: there should be no pending event when resume "
                                     "from power mode = "
                                  << mPowerMode << " to power mode = " << powerMode;
@@ -730,7 +730,11 @@ void VariableRefreshRateController::onPresent(int fence) {
             // post the next frame insertion event
             if (presentTimeoutNs) {
                 // Convert the relative time clock from now to the absolute steady time clock.
-                presentTimeoutNs = getSteadyClockTimeNs() + presentTimeoutNs;
+                presentTimeoutNs += getSteadyClockTimeNs();
+                // An override is honored as given.
+                if (!mVendorPresentTimeoutOverride) {
+                    presentTimeoutNs = alignToVsyncTimelineLocked(presentTimeoutNs);
+                }
                 postEvent(VrrControllerEventType::kVendorRenderingTimeout, presentTimeoutNs);
             }
         }
@@ -755,44 +759,35 @@ void VariableRefreshRateController::onVsync(int64_t timestampNanos,
                        .mTime = timestampNanos};
 }
 
+int64_t VariableRefreshRateController::alignToVsyncTimelineLocked(int64_t timeNs) const {
+    std::vector<nsecs_t> vsyncs;
+    if (mDisplay->getPredictedVsyncs(timeNs, 1, vsyncs) != NO_ERROR) {
+        return timeNs;
+    }
+    // The panel timeout is a lower bound, so never move the event earlier.
+    return std::max<int64_t>(vsyncs[0], timeNs);
+}
+
 void VariableRefreshRateController::cancelPresentTimeoutHandlingLocked() {
     dropEventLocked(VrrControllerEventType::kVendorRenderingTimeout);
     dropEventLocked(VrrControllerEventType::kHandleVendorRenderingTimeout);
 }
 
 void VariableRefreshRateController::dropEventLocked() {
-    mEventQueue.mPriorityQueue = std::priority_queue<VrrControllerEvent>();
+    mEventQueue.dropEvent();
 }
 
 void VariableRefreshRateController::dropEventLocked(VrrControllerEventType eventType) {
-    std::priority_queue<VrrControllerEvent> q;
-    auto target = static_cast<int>(eventType);
-    while (!mEventQueue.mPriorityQueue.empty()) {
-        const auto& it = mEventQueue.mPriorityQueue.top();
-        if ((static_cast<int>(it.mEventType) & target) != target) {
-            q.push(it);
-        }
-        mEventQueue.mPriorityQueue.pop();
-    }
-    mEventQueue.mPriorityQueue = std::move(q);
+    mEventQueue.dropEventByMask(eventType);
 }
 
 std::string VariableRefreshRateController::dumpEventQueueLocked() {
     std::string content;
-    if (mEventQueue.mPriorityQueue.empty()) {
-        return content;
-    }
-
-    std::priority_queue<VrrControllerEvent> q;
-    while (!mEventQueue.mPriorityQueue.empty()) {
-        const auto& it = mEventQueue.mPriorityQueue.top();
+    for (const auto& [whenNs, event] : mEventQueue.events()) {
         content += "VrrController: event = ";
-        content += it.toString();
+        content += event.toString();
         content += "\n";
-        q.push(it);
-        mEventQueue.mPriorityQueue.pop();
     }
-    mEventQueue.mPriorityQueue = std::move(q);
     return content;
 }
 
@@ -834,11 +829,11 @@ int64_t VariableRefreshRateController::getLastFenceSignalTimeUnlocked(int fd) {
 }
 
 int64_t VariableRefreshRateController::getNextEventTimeLocked() const {
-    if (mEventQueue.mPriorityQueue.empty()) {
+    if (mEventQueue.empty()) {
         LOG(WARNING) << "VrrController: event queue should NOT be empty.";
         return -1;
     }
-    const auto& event = mEventQueue.mPriorityQueue.top();
+    const auto& event = mEventQueue.top();
     return event.mWhenNs;
 }
 
@@ -1008,7 +1003,7 @@ void VariableRefreshRateController::threadBody() {
             if (!mEnabled) mCondition.wait(lock);
             if (!mEnabled) continue;
 
-            if (mEventQueue.mPriorityQueue.empty()) {
+            if (mEventQueue.empty()) {
                 mCondition.wait(lock);
             }
             int64_t whenNs = getNextEventTimeLocked();
@@ -1021,15 +1016,15 @@ void VariableRefreshRateController::threadBody() {
                 }
             }
 
-            if (mEventQueue.mPriorityQueue.empty()) {
+            if (mEventQueue.empty()) {
                 continue;
             }
 
-            auto event = mEventQueue.mPriorityQueue.top();
+            auto event = mEventQueue.top();
             if (event.mWhenNs > getSteadyClockTimeNs()) {
                 continue;
             }
-            mEventQueue.mPriorityQueue.pop();
+            mEventQueue.pop();
             if (static_cast<int>(event.mEventType) &
                 static_cast<int>(VrrControllerEventType::kCallbackEventMask)) {
                 handleCallbackEventLocked(event);
@@ -1134,7 +1129,7 @@ void VariableRefreshRateController::postEvent(VrrControllerEventType type, int64
     VrrControllerEvent event;
     event.mEventType = type;
     event.mWhenNs = when;
-    mEventQueue.mPriorityQueue.emplace(event);
+    mEventQueue.postEvent(std::move(event));
 }
 
 void VariableRefreshRateController::postEvent(VrrControllerEventType type, TimedEvent& timedEvent) {
@@ -1143,7 +1138,7 @@ void VariableRefreshRateController::postEvent(VrrControllerEventType type, Timed
     event.mWhenNs = timedEvent.mIsRelativeTime ? (getSteadyClockTimeNs() + timedEvent.mWhenNs)
                                                : timedEvent.mWhenNs;
     event.mFunctor = std::move(timedEvent.mFunctor);
-    mEventQueue.mPriorityQueue.emplace(event);
+    mEventQueue.postEvent(std::move(event));
 }
 
 void VariableRefreshRateController::updateVsyncHistory() {
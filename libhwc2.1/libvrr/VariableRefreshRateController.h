@@ -233,6 +233,11 @@ private:
     // Implement interface VsyncListener.
     virtual void onVsync(int64_t timestamp, int32_t vsyncPeriodNanos) override;
 
+    // Moves |timeNs| to the first vsync predicted by the display at or after it, so that events
+    // handled at |timeNs| start at a TE boundary of the panel. Returns |timeNs| unchanged if there
+    // is no prediction.
+    int64_t alignToVsyncTimelineLocked(int64_t timeNs) const;
+
     void cancelPresentTimeoutHandlingLocked();
 
     void dropEventLocked();
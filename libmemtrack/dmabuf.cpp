@@ -1,10 +1,15 @@
+#include <chrono>
 #include <fstream>
+#include <mutex>
 #include <sstream>
-#include <regex>
+#include <string>
+#include <unordered_map>
 #include <vector>
-#include <algorithm>
 
+#include <cctype>
 #include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <sys/stat.h>
 
 #include <hardware/memtrack.h>
@@ -30,10 +35,49 @@ struct DmabufBuffer {
     DmabufBuffer(unsigned int _id, size_t _size, size_t _pss)
         : id(_id), type(MEMTRACK_FLAG_SMAPS_UNACCOUNTED | MEMTRACK_FLAG_SHARED_PSS), size(_size), pss(_pss)
     { }
-    void setPoolType(string _type) { type |= (_type == "carveout") ? MEMTRACK_FLAG_DEDICATED : MEMTRACK_FLAG_SYSTEM; }
+    void setPoolType(const string &_type) { type |= (_type == "carveout") ? MEMTRACK_FLAG_DEDICATED : MEMTRACK_FLAG_SYSTEM; }
     void setFlags(unsigned int flags) { type |= (flags & ION_FLAG_PROTECTED) ? MEMTRACK_FLAG_SECURE : MEMTRACK_FLAG_NONSECURE; }
 };
 
+/*
+ * Minimal tokenizer helpers for the debugfs tables below. They replace
+ * std::regex, which dominated the cost of a query on devices with many buffers.
+ */
+static inline bool skip_spaces(const char *&p, bool required)
+{
+    const char *start = p;
+    while (isspace(static_cast<unsigned char>(*p)))
+        p++;
+    return !required || (p != start);
+}
+
+static inline bool parse_number(const char *&p, int base, unsigned long &value)
+{
+    char *end;
+    if (!isxdigit(static_cast<unsigned char>(*p)))
+        return false;
+    errno = 0;
+    value = strtoul(p, &end, base);
+    if ((end == p) || (errno == ERANGE))
+        return false;
+    p = end;
+    return true;
+}
+
+static inline bool parse_token(const char *&p, bool (*accept)(char), string &token)
+{
+    const char *start = p;
+    while ((*p != '\0') && accept(*p))
+        p++;
+    if (p == start)
+        return false;
+    token.assign(start, p - start);
+    return true;
+}
+
+static bool is_heap_name_char(char c) { return isalnum(static_cast<unsigned char>(c)) || (c == '-') || (c == '_'); }
+static bool is_word_char(char c) { return isalnum(static_cast<unsigned char>(c)) || (c == '_'); }
+
 const char DMABUF_FOOTPRINT_PATH[] = "/sys/kernel/debug/dma_buf/footprint/";
 static bool build_dmabuf_footprint(vector<DmabufBuffer> &buffers, pid_t pid)
 {
@@ -46,18 +90,47 @@ static bool build_dmabuf_footprint(vector<DmabufBuffer> &buffers, pid_t pid)
     //
     // exp_name      size     share
     // ion-102   69271552  34635776
-    regex rex("\\s*ion-(\\d+)\\s+(\\d+)\\s+(\\d+).*");
-    smatch mch;
-    // 1-id, 2-size, 3-pss
-    for (string line; getline(dmabuf, line); )
-        if (regex_match(line, mch, rex))
-            buffers.emplace_back(stoul(mch[1], 0, 10), stoul(mch[2], 0, 10), stoul(mch[3], 0, 10));
+    for (string line; getline(dmabuf, line); ) {
+        const char *p = line.c_str();
+        unsigned long id, size, pss;
+
+        skip_spaces(p, false);
+        if (strncmp(p, "ion-", 4) != 0)
+            continue;
+        p += 4;
+        if (!isdigit(static_cast<unsigned char>(*p)) || !parse_number(p, 10, id) ||
+                !skip_spaces(p, true) || !isdigit(static_cast<unsigned char>(*p)) ||
+                !parse_number(p, 10, size) ||
+                !skip_spaces(p, true) || !isdigit(static_cast<unsigned char>(*p)) ||
+                !parse_number(p, 10, pss))
+            continue;
+        buffers.emplace_back(id, size, pss);
+    }
 
     return true;
 }
 
+struct IonBuffer {
+    size_t size;
+    unsigned int flags;
+    string heaptype;
+};
+
+/*
+ * The ion buffer table is global, so one parse serves the per-pid queries that
+ * memtrack clients issue back to back for every process.
+ */
+#define ION_SNAPSHOT_VALID_MS 500
+struct IonSnapshot {
+    mutex lock;
+    chrono::steady_clock::time_point time;
+    bool valid = false;
+    unordered_map<unsigned int, IonBuffer> buffers;
+};
+static IonSnapshot ion_snapshot;
+
 const char ION_BUFFERS_PATH[] = "/sys/kernel/debug/ion/buffers";
-static bool complete_dmabuf_footprint(int type, vector<DmabufBuffer> &buffers)
+static bool parse_ion_buffers(unordered_map<unsigned int, IonBuffer> &table)
 {
     ifstream ion(ION_BUFFERS_PATH);
     if (!ion)
@@ -65,22 +138,53 @@ static bool complete_dmabuf_footprint(int type, vector<DmabufBuffer> &buffers)
 
     // [  id]            heap heaptype flags size(kb) : iommu_mapped...
     // [ 106] ion_system_heap   system  0x40    16912 : 19080000.dsim(0)
-    regex rexion("\\[ *(\\d+)\\] +[[:alnum:]\\-_]+ +(\\w+) +([x[:xdigit:]]+) +(\\d+).*");
-    smatch mch;
-    // 1-id, 2-heaptype, 3-flags, 4-size
+    string heapname;
     for (string line; getline(ion, line); ) {
-        if (regex_match(line, mch, rexion)) {
-            unsigned int id = stoul(mch[1], 0, 10);
-            unsigned int flags = stoul(mch[3], 0, 16);
-            size_t len = stoul(mch[4], 0, 10) * 1024;
-            auto elem = find_if(begin(buffers), end(buffers), [id, len] (auto &item) {
-                                    return (item.id == id) && (item.size == len);
-                                });
-            // passes if type = OTHER && not flag & hwrender or type == GRAPHIC && flag & hwrender
-            if ((elem != end(buffers)) && ((type == MEMTRACK_TYPE_OTHER) == !(flags & ION_FLAG_MAY_HWRENDER))) {
-                elem->setFlags(flags);
-                elem->setPoolType(mch[2]);
-            }
+        const char *p = line.c_str();
+        unsigned long id, flags, size;
+        IonBuffer buffer;
+
+        if (*p++ != '[')
+            continue;
+        skip_spaces(p, false);
+        if (!isdigit(static_cast<unsigned char>(*p)) || !parse_number(p, 10, id) || (*p++ != ']'))
+            continue;
+        if (!skip_spaces(p, true) || !parse_token(p, is_heap_name_char, heapname) ||
+                !skip_spaces(p, true) || !parse_token(p, is_word_char, buffer.heaptype) ||
+                !skip_spaces(p, true) || !parse_number(p, 16, flags) ||
+                !skip_spaces(p, true) || !isdigit(static_cast<unsigned char>(*p)) ||
+                !parse_number(p, 10, size))
+            continue;
+        buffer.flags = flags;
+        buffer.size = size * 1024;
+        table.emplace(id, move(buffer));
+    }
+
+    return true;
+}
+
+static bool complete_dmabuf_footprint(int type, vector<DmabufBuffer> &buffers)
+{
+    lock_guard<mutex> lock(ion_snapshot.lock);
+    auto now = chrono::steady_clock::now();
+
+    if (!ion_snapshot.valid ||
+            (now - ion_snapshot.time > chrono::milliseconds(ION_SNAPSHOT_VALID_MS))) {
+        ion_snapshot.buffers.clear();
+        ion_snapshot.valid = parse_ion_buffers(ion_snapshot.buffers);
+        ion_snapshot.time = now;
+        if (!ion_snapshot.valid)
+            return false;
+    }
+
+    for (auto &item: buffers) {
+        auto ion = ion_snapshot.buffers.find(item.id);
+        if ((ion == ion_snapshot.buffers.end()) || (ion->second.size != item.size))
+            continue;
+        // passes if type = OTHER && not flag & hwrender or type == GRAPHIC && flag & hwrender
+        if ((type == MEMTRACK_TYPE_OTHER) == !(ion->second.flags & ION_FLAG_MAY_HWRENDER)) {
+            item.setFlags(ion->second.flags);
+            item.setPoolType(ion->second.heaptype);
         }
     }
 
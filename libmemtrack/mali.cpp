@@ -17,6 +17,7 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <log/log.h>
@@ -25,6 +26,12 @@
 
 #include "memtrack_exynos.h"
 
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 /* Following includes added for directory parsing. */
 #include <sys/types.h>
 #include <dirent.h>
@@ -34,9 +41,22 @@
 #define MALI_DEBUG_MEM_FILE		"/mem_profile"
 
 #define MAX_FILES_PER_PID 		8
-#define MAX_FILES_PER_NAME		32
-static int libmemtrack_gbl_input_filename_counter = 	0;
-static char libmemtrack_gbl_input_filename[MAX_FILES_PER_PID][MAX_FILES_PER_NAME];
+
+/*
+ * The debugfs directory is indexed by pid once and the index is reused for
+ * MALI_INDEX_VALID_MS, so that a query of every process in the system walks
+ * the directory once instead of once per process.
+ */
+#define MALI_INDEX_VALID_MS		500
+
+struct MaliFileIndex {
+    std::mutex lock;
+    std::chrono::steady_clock::time_point time;
+    bool valid = false;
+    std::unordered_map<pid_t, std::vector<std::string>> files;
+};
+
+static MaliFileIndex libmemtrack_gbl_file_index;
 
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
 #define min(x, y) ((x) < (y) ? (x) : (y))
@@ -54,47 +74,52 @@ struct memtrack_record record_templates[] = {
     },
 };
 
-static void scan_directory_for_filenames(pid_t pid)
+static void build_file_index(MaliFileIndex &index)
 {
-    /* As per ARM, there can be multiple files */
+    /* As per ARM, there can be multiple files per pid, named "<pid>_<id>" */
     DIR *directory;
     struct dirent *entries;
-    char pid_string[12] = {0};
-    int pid_index = 0;
+
+    index.files.clear();
 
     /* Open directory. */
     directory = opendir(MALI_DEBUG_FS_PATH);
+    if (directory == NULL) {
+        ALOGE("libmemtrack-hw -- Couldn't open the directory - %s \r\n", MALI_DEBUG_FS_PATH);
+        return;
+    }
 
-    sprintf(pid_string, "%d", pid);
-    for (pid_index = 0; pid_index < 12; pid_index++) {
-        if (pid_string[pid_index] == 0) {
-            pid_string[pid_index] = '_';
-            break;
-        }
+    /* Keep reading the directory. */
+    while ((entries = readdir(directory))) {
+        char *end;
+        long pid = strtol(entries->d_name, &end, 10);
+
+        if ((end == entries->d_name) || (*end != '_'))
+            continue;
+
+        std::vector<std::string> &files = index.files[static_cast<pid_t>(pid)];
+        if (files.size() < MAX_FILES_PER_PID)
+            files.push_back(std::string(MALI_DEBUG_FS_PATH) + entries->d_name + MALI_DEBUG_MEM_FILE);
     }
 
-    libmemtrack_gbl_input_filename_counter = 0;
-
-    if (directory != NULL) {
-        /* Keep reading the directory. */
-        while ((entries = readdir(directory))) {
-            /* Check if the PID is present in the direcotry entry.
-             * If it is present, then keep the filename for reading
-             * contents. Also concatenate the directory path, so that
-             * file can be opened.
-             * */
-            if (!strncmp(entries->d_name, pid_string, strlen(pid_string))) {
-                snprintf(&libmemtrack_gbl_input_filename[libmemtrack_gbl_input_filename_counter][0], MAX_FILES_PER_NAME, "%s%s%s", MALI_DEBUG_FS_PATH, entries->d_name, MALI_DEBUG_MEM_FILE);
-                libmemtrack_gbl_input_filename_counter++;
-            }
-        }
-        /* Close directory before leaving. */
-        (void) closedir(directory);
-    } else {
-        ALOGE("libmemtrack-hw -- Couldn't open the directory - %s \r\n", MALI_DEBUG_FS_PATH);
+    /* Close directory before leaving. */
+    (void) closedir(directory);
+}
+
+static std::vector<std::string> scan_directory_for_filenames(pid_t pid)
+{
+    MaliFileIndex &index = libmemtrack_gbl_file_index;
+    std::lock_guard<std::mutex> lock(index.lock);
+    auto now = std::chrono::steady_clock::now();
+
+    if (!index.valid || (now - index.time > std::chrono::milliseconds(MALI_INDEX_VALID_MS))) {
+        build_file_index(index);
+        index.time = now;
+        index.valid = true;
     }
 
-    return;
+    auto it = index.files.find(pid);
+    return (it == index.files.end()) ? std::vector<std::string>() : it->second;
 }
 
 int mali_memtrack_get_memory(pid_t pid, int __unused type,
@@ -118,15 +143,15 @@ int mali_memtrack_get_memory(pid_t pid, int __unused type,
     memcpy(records, record_templates,
            sizeof(struct memtrack_record) * allocated_records);
 
-    /* First, scan the directoy. */
-    scan_directory_for_filenames(pid);
+    /* First, look up the files of the pid. */
+    std::vector<std::string> filenames = scan_directory_for_filenames(pid);
 
     local_count = 0;
     total_memory_size = 0;
     native_buf_mem_size = 0;
 
-    while (local_count < libmemtrack_gbl_input_filename_counter) {
-        fp = fopen(&libmemtrack_gbl_input_filename[local_count][0], "r");
+    while (local_count < static_cast<int>(filenames.size())) {
+        fp = fopen(filenames[local_count].c_str(), "r");
 
         if (fp == NULL) {
             /* Unable to open the file. Either move to next file, or
@@ -220,7 +245,7 @@ int mali_memtrack_get_memory(pid_t pid, int __unused type,
         /* Manage local variables and counters. */
         local_count++;
 
-    } /* while (local_count <= libmemtrack_gbl_input_filename_counter) */
+    } /* while (local_count < filenames.size()) */
 
     /* Arrange and return memory size details. */
     if (allocated_records > 0)
@@ -189,6 +189,9 @@ int exynos_sc_destroy(void *handle);
 
 /*!
  * Convert color space with presetup color format
+ * It waits for the conversions submitted by exynos_sc_submit() as well.
+ * The device keeps streaming for the next conversion unless the
+ * configuration is changed.
  *
  * \ingroup exynos_scaler
  *
@@ -200,6 +203,52 @@ int exynos_sc_destroy(void *handle);
  */
 int exynos_sc_convert(void *handle);
 
+/*!
+ * Set the number of conversions in flight by exynos_sc_submit() (optional).
+ * The default is 1.
+ *
+ * \ingroup exynos_scaler
+ *
+ * \param handle
+ *   libscaler handle[in]
+ *
+ * \param depth
+ *   queue depth from 1 to 4[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_sc_set_queue_depth(void *handle, unsigned int depth);
+
+/*!
+ * Start a conversion with presetup color format without waiting for it.
+ * It waits for the oldest conversion if the queue is full.
+ * The buffers should not be accessed until exynos_sc_complete() returns
+ * for the conversion.
+ *
+ * \ingroup exynos_scaler
+ *
+ * \param handle
+ *   libscaler handle[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_sc_submit(void *handle);
+
+/*!
+ * Wait for the oldest conversion started by exynos_sc_submit()
+ *
+ * \ingroup exynos_scaler
+ *
+ * \param handle
+ *   libscaler handle[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_sc_complete(void *handle);
+
 /*!
  * Convert color space with presetup color format
  *
@@ -425,6 +474,22 @@ int exynos_sc_set_rotation(
 void exynos_sc_set_framerate(
         void *handle,
         int framerate);
+
+/*!
+ * Use bilinear filtering instead of nearest neighbour when the scale-down
+ * ratio is too large for H/W and S/W scaling is used (optional).
+ *
+ * \ingroup exynos_scaler
+ *
+ * \param handle
+ *   libscaler handle[in]
+ *
+ * \param bilinear
+ *   nonzero to enable bilinear filtering[in]
+ */
+void exynos_sc_set_sw_bilinear(
+        void *handle,
+        int bilinear);
 ////// non-blocking /////
 
 void *exynos_sc_create_exclusive(
@@ -79,7 +79,7 @@ const static PixFormat g_pixfmt_table[] = {
 };
 
 
-CScalerM2M1SHOT::CScalerM2M1SHOT(int devid, int __UNUSED__ drm) : m_iFD(-1)
+CScalerM2M1SHOT::CScalerM2M1SHOT(int devid, int __UNUSED__ drm) : m_iFD(-1), m_bSWBilinear(false)
 {
     memset(&m_task, 0, sizeof(m_task));
 
@@ -335,6 +335,8 @@ bool CScalerM2M1SHOT::RunSWScaling()
             m_task.fmt_cap.crop.width, m_task.fmt_cap.crop.height,
             m_task.fmt_cap.width);
 
+    swsc->SetBilinear(m_bSWBilinear);
+
     bool ret = swsc->Scale();
 
     delete swsc;
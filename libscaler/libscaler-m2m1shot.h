@@ -33,6 +33,7 @@
 class CScalerM2M1SHOT {
     int m_iFD;
     m2m1shot m_task;
+    bool m_bSWBilinear;
 
     bool SetFormat(m2m1shot_pix_format &fmt, m2m1shot_buffer &buf,
                    unsigned int width, unsigned int height, unsigned int v4l2_fmt);
@@ -98,6 +99,10 @@ public:
         m_task.reserved[0] = (unsigned long)framerate;
     }
 
+    inline void SetSWBilinear(bool bilinear) {
+        m_bSWBilinear = bilinear;
+    }
+
     /* No effect in M2M1SHOT */
     inline void SetDRM(bool __UNUSED__ drm) { }
     inline void SetSrcPremultiplied(bool __UNUSED__ premultiplied) { }
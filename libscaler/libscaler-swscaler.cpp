@@ -1,5 +1,210 @@
+#include <cstring>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "libscaler-swscaler.h"
 
+#define SW_SCALE_ONE  (1 << 16)
+#define SW_SCALE_HALF (2 << 16)
+
+// Source positions in 16.16 fixed point for each destination pixel of a line,
+// stepping from start by ratio and clamped at end.
+static void BuildPositions(std::vector<unsigned int> &pos, unsigned int count,
+        unsigned int start, unsigned int ratio, unsigned int end)
+{
+    pos.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        pos[i] = start;
+        start = LibScaler::min(start + ratio, end);
+    }
+}
+
+static inline unsigned char Bilerp(const unsigned char *row0, const unsigned char *row1,
+        unsigned int i0, unsigned int i1, unsigned int fx, unsigned int fy)
+{
+    unsigned int top = row0[i0] * (256 - fx) + row0[i1] * fx;
+    unsigned int bottom = row1[i0] * (256 - fx) + row1[i1] * fx;
+
+    return static_cast<unsigned char>((top * (256 - fy) + bottom * fy + (1 << 15)) >> 16);
+}
+
+// dst[i] = src[pos[i] >> 16]
+static void ScaleRow8(unsigned char *dst, const unsigned char *src,
+        const unsigned int *pos, unsigned int count, unsigned int ratio)
+{
+    unsigned int i = 0;
+
+    if (ratio == SW_SCALE_ONE) {
+        memcpy(dst, src + (pos[0] >> 16), count);
+        return;
+    }
+
+    if (ratio == SW_SCALE_HALF) {
+        const unsigned char *s = src + (pos[0] >> 16);
+#if defined(__ARM_NEON)
+        for (; i + 16 <= count; i += 16)
+            vst1q_u8(dst + i, vld2q_u8(s + i * 2).val[0]);
+#elif defined(__SSE2__)
+        const __m128i even = _mm_set1_epi16(0x00FF);
+        for (; i + 16 <= count; i += 16) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i * 2));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i * 2 + 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                    _mm_packus_epi16(_mm_and_si128(lo, even), _mm_and_si128(hi, even)));
+        }
+#endif
+        for (; i < count; i++)
+            dst[i] = s[i * 2];
+        return;
+    }
+
+    for (; i < count; i++)
+        dst[i] = src[pos[i] >> 16];
+}
+
+// Same as ScaleRow8 for 2-byte pixels such as the CbCr pairs of NV12
+static void ScaleRow16(unsigned short *dst, const unsigned short *src,
+        const unsigned int *pos, unsigned int count, unsigned int ratio)
+{
+    unsigned int i = 0;
+
+    if (ratio == SW_SCALE_ONE) {
+        memcpy(dst, src + (pos[0] >> 16), count * sizeof(*dst));
+        return;
+    }
+
+    if (ratio == SW_SCALE_HALF) {
+        const unsigned short *s = src + (pos[0] >> 16);
+#if defined(__ARM_NEON)
+        for (; i + 8 <= count; i += 8)
+            vst1q_u16(dst + i, vld2q_u16(s + i * 2).val[0]);
+#elif defined(__SSE2__)
+        for (; i + 8 <= count; i += 8) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i * 2));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i * 2 + 8));
+            // sign-extend the low halfword of each word so that packs keeps it intact
+            lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+            hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+        }
+#endif
+        for (; i < count; i++)
+            dst[i] = s[i * 2];
+        return;
+    }
+
+    for (; i < count; i++)
+        dst[i] = src[pos[i] >> 16];
+}
+
+// YUYV: luma of each pixel from its own source pixel, chroma of each
+// even destination pixel from the macro pixel holding its source pixel.
+// odd is set when the row starts at an odd destination pixel.
+static void ScaleRowYUYV(unsigned char *dst, const unsigned char *src,
+        const unsigned int *pos, unsigned int count, unsigned int ratio, bool odd)
+{
+    unsigned int i = 0;
+
+    if (!odd && (ratio == SW_SCALE_ONE)) {
+        memcpy(dst, src + (pos[0] >> 16) * 2, count * 2);
+        return;
+    }
+
+    if (!odd && (ratio == SW_SCALE_HALF)) {
+        // Every destination macro pixel takes Y0, U and V of an even source
+        // macro pixel and Y0 of the odd one next to it.
+        const unsigned char *s = src + (pos[0] >> 16) * 2;
+        unsigned char *d = dst;
+#if defined(__ARM_NEON)
+        for (; i + 32 <= count; i += 32, s += 128, d += 64) {
+            uint8x16x4_t a = vld4q_u8(s);
+            uint8x16x4_t b = vld4q_u8(s + 64);
+            uint8x16x2_t y = vuzpq_u8(a.val[0], b.val[0]);
+            uint8x16x4_t out;
+
+            out.val[0] = y.val[0];
+            out.val[1] = vuzpq_u8(a.val[1], b.val[1]).val[0];
+            out.val[2] = y.val[1];
+            out.val[3] = vuzpq_u8(a.val[3], b.val[3]).val[0];
+            vst4q_u8(d, out);
+        }
+#elif defined(__SSE2__)
+        const __m128i keep = _mm_set1_epi64x(0xFF00FFFF);
+        const __m128i y0 = _mm_set1_epi64x(0x00FF0000);
+        for (; i + 8 <= count; i += 8, s += 32, d += 16) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16));
+            lo = _mm_or_si128(_mm_and_si128(lo, keep), _mm_and_si128(_mm_srli_epi64(lo, 16), y0));
+            hi = _mm_or_si128(_mm_and_si128(hi, keep), _mm_and_si128(_mm_srli_epi64(hi, 16), y0));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                    _mm_unpacklo_epi64(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0)),
+                                       _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0))));
+        }
+#endif
+        for (; i < count; i += 2, s += 8, d += 4) {
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[4];
+            d[3] = s[3];
+        }
+        return;
+    }
+
+    for (; i < count; i++) {
+        unsigned int sx = pos[i] >> 16;
+
+        dst[i * 2] = src[sx * 2];
+        if (((i + odd) & 1) == 0) {
+            unsigned int cx = sx & ~1;
+
+            dst[i * 2 + 1] = src[cx * 2 + 1];
+            dst[i * 2 + 3] = src[cx * 2 + 3];
+        }
+    }
+}
+
+static void ScaleRowYUYVBilinear(unsigned char *dst, const unsigned char *row0,
+        const unsigned char *row1, unsigned int fy, const unsigned int *pos,
+        unsigned int count, unsigned int last, bool odd)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int x0 = pos[i] >> 16;
+        unsigned int x1 = LibScaler::min(x0 + 1, last);
+
+        dst[i * 2] = Bilerp(row0, row1, x0 * 2, x1 * 2, (pos[i] >> 8) & 0xFF, fy);
+        if (((i + odd) & 1) == 0) {
+            unsigned int mpos = pos[i] >> 1;
+            unsigned int m0 = mpos >> 16;
+            unsigned int m1 = LibScaler::min(m0 + 1, last / 2);
+            unsigned int fx = (mpos >> 8) & 0xFF;
+
+            dst[i * 2 + 1] = Bilerp(row0, row1, m0 * 4 + 1, m1 * 4 + 1, fx, fy);
+            dst[i * 2 + 3] = Bilerp(row0, row1, m0 * 4 + 3, m1 * 4 + 3, fx, fy);
+        }
+    }
+}
+
+// Bilinear over a plane of interleaved channels, e.g. 1 for Y and 2 for CbCr
+static void ScaleRowBilinear(unsigned char *dst, const unsigned char *row0,
+        const unsigned char *row1, unsigned int fy, const unsigned int *pos,
+        unsigned int count, unsigned int last, unsigned int channels)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int x0 = pos[i] >> 16;
+        unsigned int x1 = LibScaler::min(x0 + 1, last);
+        unsigned int fx = (pos[i] >> 8) & 0xFF;
+
+        for (unsigned int c = 0; c < channels; c++)
+            dst[i * channels + c] = Bilerp(row0, row1,
+                    x0 * channels + c, x1 * channels + c, fx, fy);
+    }
+}
+
 void CScalerSW::Clear() {
     m_pSrc[0] = NULL;
     m_pSrc[1] = NULL;
@@ -18,6 +223,8 @@ void CScalerSW::Clear() {
     m_nDstWidth = 0;
     m_nDstHeight = 0;
     m_nDstStride = 0;
+
+    m_bBilinear = false;
 }
 
 bool CScalerSW_YUYV::Scale() {
@@ -29,30 +236,32 @@ bool CScalerSW_YUYV::Scale() {
     unsigned int h_ratio = (m_nSrcWidth << 16) / m_nDstWidth;
     unsigned int v_ratio = (m_nSrcHeight << 16) / m_nDstHeight;
 
-    unsigned int src_x;
-    unsigned int src_y = m_nSrcTop << 16;
-
-    // Luminance + Chrominance at once
-    for (unsigned int y = m_nDstTop; y < (m_nDstTop + m_nDstHeight); y++) {
-        src_x = m_nSrcLeft << 16;
-        for (unsigned int x = m_nDstLeft; x < (m_nDstLeft + m_nDstWidth); x++) {
-            m_pDst[0][y * (m_nDstStride * 2) + x * 2] =
-                m_pSrc[0][(src_y >> 16) * (m_nSrcStride * 2) + (src_x >> 16) * 2];
-
-            if (!(x & 1)) {
-                unsigned int cx = (src_x >> 16) & ~1;
+    std::vector<unsigned int> xpos, ypos;
+    BuildPositions(xpos, m_nDstWidth, m_nSrcLeft << 16, h_ratio, (m_nSrcLeft + m_nSrcWidth) << 16);
+    BuildPositions(ypos, m_nDstHeight, m_nSrcTop << 16, v_ratio, (m_nSrcTop + m_nSrcHeight) << 16);
 
-                m_pDst[0][y * (m_nDstStride * 2) + x * 2 + 1] =
-                    m_pSrc[0][(src_y >> 16) * (m_nSrcStride * 2) + cx * 2 + 1];
-                m_pDst[0][y * (m_nDstStride * 2) + x * 2 + 3] =
-                    m_pSrc[0][(src_y >> 16) * (m_nSrcStride * 2) + cx * 2 + 3];
+    unsigned char *src = reinterpret_cast<unsigned char *>(m_pSrc[0]);
+    unsigned char *dst = reinterpret_cast<unsigned char *>(m_pDst[0]) + m_nDstLeft * 2;
+    bool odd = (m_nDstLeft & 1) != 0;
+    unsigned int last_x = m_nSrcLeft + m_nSrcWidth - 1;
+    unsigned int last_y = m_nSrcTop + m_nSrcHeight - 1;
 
-            }
+    // Luminance + Chrominance at once
+    for (unsigned int y = 0; y < m_nDstHeight; y++) {
+        unsigned char *drow = dst + (m_nDstTop + y) * (m_nDstStride * 2);
+        unsigned int sy = ypos[y] >> 16;
 
-            src_x = LibScaler::min(src_x + h_ratio, (m_nSrcLeft + m_nSrcWidth) << 16);
+        if (m_bBilinear) {
+            ScaleRowYUYVBilinear(drow, src + sy * (m_nSrcStride * 2),
+                    src + LibScaler::min(sy + 1, last_y) * (m_nSrcStride * 2),
+                    (ypos[y] >> 8) & 0xFF, xpos.data(), m_nDstWidth, last_x, odd);
+        } else if (!odd && (y > 0) && (sy == (ypos[y - 1] >> 16))) {
+            // vertical upscaling repeats the row just scaled
+            memcpy(drow, drow - (m_nDstStride * 2), m_nDstWidth * 2);
+        } else {
+            ScaleRowYUYV(drow, src + sy * (m_nSrcStride * 2),
+                    xpos.data(), m_nDstWidth, h_ratio, odd);
         }
-
-        src_y = LibScaler::min(src_y + v_ratio, (m_nSrcTop + m_nSrcHeight) << 16);
     }
 
     return true;
@@ -68,38 +277,62 @@ bool CScalerSW_NV12::Scale() {
     unsigned int h_ratio = (m_nSrcWidth << 16) / m_nDstWidth;
     unsigned int v_ratio = (m_nSrcHeight << 16) / m_nDstHeight;
 
-    unsigned int src_x;
-    unsigned int src_y = m_nSrcTop << 16;
+    std::vector<unsigned int> xpos, ypos;
 
     // Luminance
-    for (unsigned int y = m_nDstTop; y < (m_nDstTop + m_nDstHeight); y++) {
-        src_x = m_nSrcLeft << 16;
-        for (unsigned int x = m_nDstLeft; x < (m_nDstLeft + m_nDstWidth); x++) {
-            m_pDst[0][y * m_nDstStride + x] = m_pSrc[0][(src_y >> 16) * m_nSrcStride + (src_x >> 16)];
+    BuildPositions(xpos, m_nDstWidth, m_nSrcLeft << 16, h_ratio, (m_nSrcLeft + m_nSrcWidth) << 16);
+    BuildPositions(ypos, m_nDstHeight, m_nSrcTop << 16, v_ratio, (m_nSrcTop + m_nSrcHeight) << 16);
 
-            src_x = LibScaler::min(src_x + h_ratio, (m_nSrcLeft + m_nSrcWidth) << 16);
-        }
+    unsigned char *src = reinterpret_cast<unsigned char *>(m_pSrc[0]);
+    unsigned char *dst = reinterpret_cast<unsigned char *>(m_pDst[0]) + m_nDstLeft;
+    unsigned int last_x = m_nSrcLeft + m_nSrcWidth - 1;
+    unsigned int last_y = m_nSrcTop + m_nSrcHeight - 1;
+
+    for (unsigned int y = 0; y < m_nDstHeight; y++) {
+        unsigned char *drow = dst + (m_nDstTop + y) * m_nDstStride;
+        unsigned int sy = ypos[y] >> 16;
 
-        src_y = LibScaler::min(src_y + v_ratio, (m_nSrcTop + m_nSrcHeight) << 16);
+        if (m_bBilinear) {
+            ScaleRowBilinear(drow, src + sy * m_nSrcStride,
+                    src + LibScaler::min(sy + 1, last_y) * m_nSrcStride,
+                    (ypos[y] >> 8) & 0xFF, xpos.data(), m_nDstWidth, last_x, 1);
+        } else if ((y > 0) && (sy == (ypos[y - 1] >> 16))) {
+            memcpy(drow, drow - m_nDstStride, m_nDstWidth);
+        } else {
+            ScaleRow8(drow, src + sy * m_nSrcStride, xpos.data(), m_nDstWidth, h_ratio);
+        }
     }
 
     // Chrominance
+    unsigned int width = m_nDstWidth / 2;
+    unsigned int height = m_nDstHeight / 2;
 
-    // change pointers to 1-byte to pointers to 2-byte storage.
-    unsigned short *src = reinterpret_cast<unsigned short *>(m_pSrc[1]);
-    unsigned short *dst = reinterpret_cast<unsigned short *>(m_pDst[1]);
+    BuildPositions(xpos, width, (m_nSrcLeft / 2) << 16, h_ratio,
+            ((m_nSrcLeft + m_nSrcWidth) / 2) << 16);
+    BuildPositions(ypos, height, (m_nSrcTop / 2) << 16, v_ratio,
+            ((m_nSrcTop + m_nSrcHeight) / 2) << 16);
 
-    src_y = (m_nSrcTop / 2) << 16;
-    for (unsigned int y = m_nDstTop / 2; y < ((m_nDstTop + m_nDstHeight) / 2); y++) {
-        // Move 2 pixels at once (CbCr)
-        src_x = (m_nSrcLeft / 2) << 16;
-        for (unsigned int x = m_nDstLeft / 2; x < ((m_nDstLeft + m_nDstWidth) / 2); x++) {
-            dst[y * (m_nDstStride / 2) + x] = src[(src_y >> 16) * (m_nSrcStride / 2) + (src_x >> 16)];
+    src = reinterpret_cast<unsigned char *>(m_pSrc[1]);
+    dst = reinterpret_cast<unsigned char *>(m_pDst[1]) + m_nDstLeft;
+    last_x = (m_nSrcLeft + m_nSrcWidth) / 2 - 1;
+    last_y = (m_nSrcTop + m_nSrcHeight) / 2 - 1;
 
-            src_x = LibScaler::min(src_x + h_ratio, ((m_nSrcLeft + m_nSrcWidth) / 2) << 16);
-        }
+    for (unsigned int y = 0; y < height; y++) {
+        unsigned char *drow = dst + (m_nDstTop / 2 + y) * m_nDstStride;
+        unsigned int sy = ypos[y] >> 16;
 
-        src_y = LibScaler::min(src_y + v_ratio, ((m_nSrcTop + m_nSrcHeight) / 2) << 16);
+        if (m_bBilinear) {
+            ScaleRowBilinear(drow, src + sy * m_nSrcStride,
+                    src + LibScaler::min(sy + 1, last_y) * m_nSrcStride,
+                    (ypos[y] >> 8) & 0xFF, xpos.data(), width, last_x, 2);
+        } else if ((y > 0) && (sy == (ypos[y - 1] >> 16))) {
+            memcpy(drow, drow - m_nDstStride, width * 2);
+        } else {
+            // Move 2 pixels at once (CbCr)
+            ScaleRow16(reinterpret_cast<unsigned short *>(drow),
+                    reinterpret_cast<unsigned short *>(src + sy * m_nSrcStride),
+                    xpos.data(), width, h_ratio);
+        }
     }
 
     return true;
@@ -13,6 +13,7 @@ class CScalerSW {
         unsigned int m_nDstLeft, m_nDstTop;
         unsigned int m_nDstWidth, m_nDstHeight;
         unsigned int m_nDstStride;
+        bool m_bBilinear;
     public:
         CScalerSW() { Clear(); }
         virtual ~CScalerSW() { };
@@ -34,6 +35,10 @@ class CScalerSW {
             m_nDstHeight = height;
             m_nDstStride = stride;
         }
+
+        // Nearest neighbour by default. Bilinear costs more per pixel but avoids the
+        // blockiness of nearest neighbour on downscaled thumbnails.
+        void SetBilinear(bool bilinear) { m_bBilinear = bilinear; }
 };
 
 class CScalerSW_YUYV: public CScalerSW {
@@ -63,6 +63,8 @@ CScalerV4L2::CScalerV4L2(int instance, int allow_drm)
     m_nRotDegree = 0;
     m_fStatus = 0;
     m_filter = 0;
+    m_colorspace = V4L2_COLORSPACE_DEFAULT;
+    m_nQueueDepth = 1;
 
     memset(&m_frmSrc, 0, sizeof(m_frmSrc));
     memset(&m_frmDst, 0, sizeof(m_frmDst));
@@ -111,13 +113,35 @@ bool CScalerV4L2::Stop()
     return true;
 }
 
-bool CScalerV4L2::Run()
+bool CScalerV4L2::Drain()
+{
+    while ((m_frmSrc.buf_queued > 0) || (m_frmDst.buf_queued > 0)) {
+        if (!DQBuf())
+            return false;
+    }
+
+    return true;
+}
+
+bool CScalerV4L2::Submit()
 {
     if (LibScaler::UnderOne16thScaling(
                 m_frmSrc.crop.width, m_frmSrc.crop.height,
                 m_frmDst.crop.width, m_frmDst.crop.height,
-                m_nRotDegree))
+                m_nRotDegree)) {
+        // S/W scaling is done in place. The conversions submitted before should be completed.
+        if (!Drain())
+            return false;
+
         return RunSWScaling();
+    }
+
+    // vb2 does not pin the user pages again for a USERPTR buffer queued with
+    // the same index and address, even if they are mapped to other pages.
+    // Only DMABUF buffers are kept across conversions.
+    if (((m_frmSrc.memory == V4L2_MEMORY_USERPTR) || (m_frmDst.memory == V4L2_MEMORY_USERPTR))
+            && !Stop())
+        return false;
 
     if (!DevSetCtrl())
         return false;
@@ -136,9 +160,22 @@ bool CScalerV4L2::Run()
         return false;
     }
 
+    return true;
+}
+
+bool CScalerV4L2::Complete()
+{
     return DQBuf();
 }
 
+bool CScalerV4L2::Run()
+{
+    if (!Submit())
+        return false;
+
+    return Drain();
+}
+
 bool CScalerV4L2::SetCtrl()
 {
     struct v4l2_control ctrl;
@@ -191,7 +228,7 @@ bool CScalerV4L2::SetCtrl()
         SC_LOGD("Skipping rotation and flip setting due to no change");
     }
 
-    if (m_filter > 0) {
+    if (TestFlag(m_fStatus, SCF_FILTER_FRESH)) {
         if (!Stop())
             return false;
 
@@ -201,6 +238,7 @@ bool CScalerV4L2::SetCtrl()
             SC_LOGERR("Failed LIBSC_V4L2_CID_DNOISE_FT to %d", m_filter);
             return false;
         }
+        ClearFlag(m_fStatus, SCF_FILTER_FRESH);
     }
 
     if (TestFlag(m_fStatus, SCF_CSC_FRESH)) {
@@ -245,7 +283,8 @@ bool CScalerV4L2::DevSetCtrl()
 
 bool CScalerV4L2::ResetDevice(FrameInfo &frm)
 {
-    DQBuf(frm);
+    while (frm.buf_queued > 0)
+        DQBuf(frm);
 
     if (TestFlag(frm.flags, SCFF_STREAMING)) {
         if (ioctl(m_fdScaler, VIDIOC_STREAMOFF, &frm.type) < 0) {
@@ -254,6 +293,10 @@ bool CScalerV4L2::ResetDevice(FrameInfo &frm)
         ClearFlag(frm.flags, SCFF_STREAMING);
     }
 
+    // STREAMOFF dequeues all buffers
+    frm.buf_queued = 0;
+    frm.buf_index = 0;
+
     SC_LOGD("VIDIC_STREAMOFF is successful for the %s", frm.name);
 
     if (TestFlag(frm.flags, SCFF_REQBUFS)) {
@@ -266,6 +309,7 @@ bool CScalerV4L2::ResetDevice(FrameInfo &frm)
         }
 
         ClearFlag(frm.flags, SCFF_REQBUFS);
+        frm.buf_count = 0;
     }
 
     SC_LOGD("VIDIC_REQBUFS(0) is successful for the %s", frm.name);
@@ -356,7 +400,8 @@ bool CScalerV4L2::QBuf(FrameInfo &frm, int *pfdReleaseFence)
         return false;
     }
 
-    if (!DQBuf(frm))
+    // Wait for the oldest buffer if all buffers are in flight
+    if ((frm.buf_queued == frm.buf_count) && !DQBuf(frm))
         return false;
 
     memset(&buffer, 0, sizeof(buffer));
@@ -364,7 +409,7 @@ bool CScalerV4L2::QBuf(FrameInfo &frm, int *pfdReleaseFence)
 
     buffer.type   = frm.type;
     buffer.memory = frm.memory;
-    buffer.index  = 0;
+    buffer.index  = frm.buf_index;
     buffer.length = frm.out_num_planes;
 
     if (pfdReleaseFence) {
@@ -389,7 +434,8 @@ bool CScalerV4L2::QBuf(FrameInfo &frm, int *pfdReleaseFence)
         return false;
     }
 
-    SetFlag(frm.flags, SCFF_QBUF);
+    frm.buf_queued++;
+    frm.buf_index = (frm.buf_index + 1) % frm.buf_count;
 
     if (pfdReleaseFence) {
         if (frm.fdAcquireFence >= 0)
@@ -417,14 +463,22 @@ bool CScalerV4L2::ReqBufs(FrameInfo &frm)
 
     reqbufs.type    = frm.type;
     reqbufs.memory  = frm.memory;
-    reqbufs.count   = 1;
+    reqbufs.count   = m_nQueueDepth;
 
     if (ioctl(m_fdScaler, VIDIOC_REQBUFS, &reqbufs) < 0) {
         SC_LOGERR("Failed to REQBUFS for the %s", frm.name);
         return false;
     }
 
+    if (reqbufs.count == 0) {
+        SC_LOGE("No buffer is allocated by REQBUFS(%u) for the %s", m_nQueueDepth, frm.name);
+        return false;
+    }
+
     SetFlag(frm.flags, SCFF_REQBUFS);
+    frm.buf_count = reqbufs.count;
+    frm.buf_queued = 0;
+    frm.buf_index = 0;
 
     SC_LOGD("Successfully REQBUFS for the %s", frm.name);
 
@@ -440,17 +494,21 @@ bool CScalerV4L2::SetRotate(int rot, int flip_h, int flip_v)
 
     SetRotDegree(rot);
 
-    if (flip_h)
-        SetFlag(m_fStatus, SCF_VFLIP);
-    else
-        ClearFlag(m_fStatus, SCF_VFLIP);
-
-    if (flip_v)
-        SetFlag(m_fStatus, SCF_HFLIP);
-    else
-        ClearFlag(m_fStatus, SCF_HFLIP);
+    if (!flip_h != !TestFlag(m_fStatus, SCF_VFLIP)) {
+        if (flip_h)
+            SetFlag(m_fStatus, SCF_VFLIP);
+        else
+            ClearFlag(m_fStatus, SCF_VFLIP);
+        SetFlag(m_fStatus, SCF_ROTATION_FRESH);
+    }
 
-    SetFlag(m_fStatus, SCF_ROTATION_FRESH);
+    if (!flip_v != !TestFlag(m_fStatus, SCF_HFLIP)) {
+        if (flip_v)
+            SetFlag(m_fStatus, SCF_HFLIP);
+        else
+            ClearFlag(m_fStatus, SCF_HFLIP);
+        SetFlag(m_fStatus, SCF_ROTATION_FRESH);
+    }
 
     return true;
 }
@@ -479,7 +537,7 @@ bool CScalerV4L2::StreamOn(FrameInfo &frm)
 
 bool CScalerV4L2::DQBuf(FrameInfo &frm)
 {
-    if (!TestFlag(frm.flags, SCFF_QBUF))
+    if (frm.buf_queued == 0)
         return true;
 
     v4l2_buffer buffer;
@@ -497,7 +555,7 @@ bool CScalerV4L2::DQBuf(FrameInfo &frm)
         buffer.m.planes = plane;
     }
 
-    ClearFlag(frm.flags, SCFF_QBUF);
+    frm.buf_queued--;
 
     if (ioctl(m_fdScaler, VIDIOC_DQBUF, &buffer) < 0 ) {
         SC_LOGERR("Failed to DQBuf the %s", frm.name);
@@ -556,6 +614,10 @@ bool CScalerV4L2::RunSWScaling()
         return false;
     }
 
+    // The plane sizes below are not for H/W. S_FMT should be done again.
+    SetFlag(m_frmSrc.flags, SCFF_BUF_FRESH);
+    SetFlag(m_frmDst.flags, SCFF_BUF_FRESH);
+
     SC_LOGI("Running S/W Scaler: %dx%d -> %dx%d",
             m_frmSrc.crop.width, m_frmSrc.crop.height,
             m_frmDst.crop.width, m_frmDst.crop.height);
@@ -641,6 +703,8 @@ bool CScalerV4L2::RunSWScaling()
     swsc->SetDstRect(m_frmDst.crop.left, m_frmDst.crop.top,
             m_frmDst.crop.width, m_frmDst.crop.height, m_frmDst.width);
 
+    swsc->SetBilinear(TestFlag(m_fStatus, SCF_SW_BILINEAR));
+
     bool ret = swsc->Scale();
 
     delete swsc;
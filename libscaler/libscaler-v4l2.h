@@ -29,6 +29,7 @@
 #define _LIBSCALER_V4L2_H_
 
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <exynos_scaler.h>
 
@@ -52,6 +53,7 @@ public:
     enum { SC_MAX_PLANES = SC_NUM_OF_PLANES };
     enum { SC_MAX_NODENAME = 14 };
     enum { SC_V4L2_FMT_PREMULTI_FLAG = 10 };
+    enum { SC_MAX_QUEUE_DEPTH = 4 };
 
     enum SC_FRAME_FLAG {
         // frame status
@@ -61,7 +63,6 @@ public:
         SCFF_PREMULTIPLIED,
         // v4l2 status
         SCFF_REQBUFS,
-        SCFF_QBUF,
         SCFF_STREAMING,
     };
 
@@ -79,6 +80,10 @@ public:
         SCF_CSC_WIDE,
 	SCF_SRC_BLEND,
 	SCF_FRAMERATE,
+        SCF_CSC_VALID,
+        SCF_FILTER_FRESH,
+        SCF_QUEUE_DEPTH_FRESH,
+        SCF_SW_BILINEAR,
     };
 
     struct FrameInfo {
@@ -93,6 +98,9 @@ public:
         int out_num_planes;
         unsigned long out_plane_size[SC_MAX_PLANES];
         unsigned long flags; // enum SC_FRAME_FLAG
+        unsigned int buf_count;  // the number of buffers allocated by REQBUFS
+        unsigned int buf_queued; // the number of buffers queued and not dequeued yet
+        unsigned int buf_index;  // the index of the buffer to queue next
     };
 
 private:
@@ -101,6 +109,7 @@ private:
 
     unsigned int m_nRotDegree;
     unsigned int m_frameRate;
+    unsigned int m_nQueueDepth;
     char m_cszNode[SC_MAX_NODENAME]; // /dev/videoXX
     int m_iInstance;
 
@@ -117,8 +126,10 @@ private:
         if (rot < 0)
             rot = 360 + rot;
 
-        m_nRotDegree = rot;
-        SetFlag(m_fStatus, SCF_ROTATION_FRESH);
+        if (m_nRotDegree != static_cast<unsigned int>(rot)) {
+            m_nRotDegree = rot;
+            SetFlag(m_fStatus, SCF_ROTATION_FRESH);
+        }
     }
 
     bool DevSetFormat(FrameInfo &frm);
@@ -126,9 +137,16 @@ private:
     bool QBuf(FrameInfo &frm, int *pfdReleaseFence);
     bool StreamOn(FrameInfo &frm);
     bool DQBuf(FrameInfo &frm);
+    bool Drain();
 
+    // The format and the crop are configured again only if they are changed
+    // so that the context keeps streaming for the same configuration.
     inline bool SetFormat(FrameInfo &frm, unsigned int width, unsigned int height,
                    unsigned int v4l2_colorformat) {
+        if ((frm.color_format == v4l2_colorformat) &&
+                (frm.width == width) && (frm.height == height))
+            return true;
+
         frm.color_format = v4l2_colorformat;
         frm.width = width;
         frm.height = height;
@@ -138,6 +156,11 @@ private:
 
     inline bool SetCrop(FrameInfo &frm, unsigned int left, unsigned int top,
                  unsigned int width, unsigned int height) {
+        if ((frm.crop.left == static_cast<__s32>(left)) &&
+                (frm.crop.top == static_cast<__s32>(top)) &&
+                (frm.crop.width == width) && (frm.crop.height == height))
+            return true;
+
         frm.crop.left = left;
         frm.crop.top = top;
         frm.crop.width = width;
@@ -147,10 +170,14 @@ private:
     }
 
     inline void SetPremultiplied(FrameInfo &frm, unsigned int premultiplied) {
+        if (!premultiplied == !TestFlag(frm.flags, SCFF_PREMULTIPLIED))
+            return;
+
         if (premultiplied)
             SetFlag(frm.flags, SCFF_PREMULTIPLIED);
         else
             ClearFlag(frm.flags, SCFF_PREMULTIPLIED);
+        SetFlag(frm.flags, SCFF_BUF_FRESH);
     }
 
     inline void SetCacheable(FrameInfo &frm, bool __UNUSED__ cacheable) {
@@ -162,6 +189,10 @@ private:
         for (int i = 0; i < SC_MAX_PLANES; i++)
             frm.addr[i] = addr[i];
 
+        // REQBUFS should be done again for another memory type
+        if (frm.memory != static_cast<v4l2_memory>(mem_type))
+            SetFlag(frm.flags, SCFF_BUF_FRESH);
+
         frm.memory = static_cast<v4l2_memory>(mem_type);
         frm.fdAcquireFence = fence;
     }
@@ -199,12 +230,28 @@ public:
 
     bool Stop();
     bool Run(); // Blocking mode
+    /*
+     * Non-blocking mode: Submit() queues a conversion with the current
+     * configuration and Complete() waits for the oldest conversion submitted.
+     * Up to the queue depth conversions are in flight. Submit() waits for the
+     * oldest one if the queue is full. With USERPTR buffers, Submit() waits
+     * for all conversions in flight and releases their buffers first.
+     */
+    bool Submit();
+    bool Complete();
 
     // H/W Control
     virtual bool DevSetCtrl();
     bool DevSetFormat();
 
     inline bool ReqBufs() {
+        if (TestFlag(m_fStatus, SCF_QUEUE_DEPTH_FRESH)) {
+            if (!Stop())
+                return false;
+
+            ClearFlag(m_fStatus, SCF_QUEUE_DEPTH_FRESH);
+        }
+
         if (!ReqBufs(m_frmSrc))
             return false;
 
@@ -216,7 +263,14 @@ public:
             return false;
 
         if (!QBuf(m_frmDst, pfdDstReleaseFence)) {
-            ClearFlag(m_frmSrc.flags, SCFF_QBUF);
+            // The source buffer queued without the target is never processed.
+            // Do not wait for it but let STREAMOFF take it back.
+            m_frmSrc.buf_queued--;
+            ResetDevice(m_frmSrc);
+            if (pfdSrcReleaseFence && (*pfdSrcReleaseFence >= 0)) {
+                close(*pfdSrcReleaseFence);
+                *pfdSrcReleaseFence = -1;
+            }
             return false;
         }
         return true;
@@ -267,24 +321,35 @@ public:
     }
 
     inline void SetCSCWide(bool wide) {
+        if (TestFlag(m_fStatus, SCF_CSC_VALID) && (wide == TestFlag(m_fStatus, SCF_CSC_WIDE)))
+            return;
+
         if (wide)
             SetFlag(m_fStatus, SCF_CSC_WIDE);
         else
             ClearFlag(m_fStatus, SCF_CSC_WIDE);
 
+        SetFlag(m_fStatus, SCF_CSC_VALID);
         SetFlag(m_fStatus, SCF_CSC_FRESH);
     }
 
     inline void SetCSCEq(unsigned int v4l2_colorspace) {
         if (v4l2_colorspace == V4L2_COLORSPACE_SMPTE170M)
-            m_colorspace = V4L2_COLORSPACE_DEFAULT;
-        else
-            m_colorspace = v4l2_colorspace;
+            v4l2_colorspace = V4L2_COLORSPACE_DEFAULT;
+
+        if (TestFlag(m_fStatus, SCF_CSC_VALID) && (m_colorspace == v4l2_colorspace))
+            return;
+
+        m_colorspace = v4l2_colorspace;
+        SetFlag(m_fStatus, SCF_CSC_VALID);
         SetFlag(m_fStatus, SCF_CSC_FRESH);
     }
 
     inline void SetFilter(unsigned int filter) {
-        m_filter = filter;
+        if (m_filter != filter) {
+            m_filter = filter;
+            SetFlag(m_fStatus, SCF_FILTER_FRESH);
+        }
     }
 
     inline void SetSrcCacheable(bool cacheable) {
@@ -317,8 +382,35 @@ public:
     }
 
     inline void SetFrameRate(int framerate) {
-        m_frameRate = framerate;
-        SetFlag(m_fStatus, SCF_FRAMERATE);
+        if (m_frameRate != static_cast<unsigned int>(framerate)) {
+            m_frameRate = framerate;
+            SetFlag(m_fStatus, SCF_FRAMERATE);
+        }
+    }
+
+    // The number of conversions in flight by Submit()
+    inline bool SetQueueDepth(unsigned int depth) {
+        if ((depth == 0) || (depth > SC_MAX_QUEUE_DEPTH)) {
+            SC_LOGE("Invalid queue depth %u (max %d)", depth, SC_MAX_QUEUE_DEPTH);
+            return false;
+        }
+
+        if (m_nQueueDepth != depth) {
+            m_nQueueDepth = depth;
+            SetFlag(m_fStatus, SCF_QUEUE_DEPTH_FRESH);
+        }
+
+        return true;
+    }
+
+    inline unsigned int GetQueueDepth() { return m_nQueueDepth; }
+
+    // Bilinear filtering by S/W scaling for the scale-down ratios H/W does not support
+    inline void SetSWBilinear(bool bilinear) {
+        if (bilinear)
+            SetFlag(m_fStatus, SCF_SW_BILINEAR);
+        else
+            ClearFlag(m_fStatus, SCF_SW_BILINEAR);
     }
 };
 
@@ -430,6 +430,62 @@ int exynos_sc_convert(void *handle)
     return sc->Run() ? 0 : -1;
 }
 
+void exynos_sc_set_sw_bilinear(
+        void *handle,
+        int bilinear)
+{
+    CScalerNonStream *sc = GetNonStreamScaler(handle);
+    if (!sc)
+        return;
+
+    sc->SetSWBilinear(bilinear != 0);
+}
+
+int exynos_sc_set_queue_depth(void *handle, unsigned int depth)
+{
+    CScalerNonStream *sc = GetNonStreamScaler(handle);
+    if (!sc)
+        return -1;
+
+#ifdef SCALER_USE_M2M1SHOT
+    // m2m1shot processes a conversion at a time
+    if (depth != 1) {
+        SC_LOGE("Queue depth %u is not supported by m2m1shot", depth);
+        return -1;
+    }
+
+    return 0;
+#else
+    return sc->SetQueueDepth(depth) ? 0 : -1;
+#endif
+}
+
+int exynos_sc_submit(void *handle)
+{
+    CScalerNonStream *sc = GetNonStreamScaler(handle);
+    if (!sc)
+        return -1;
+
+#ifdef SCALER_USE_M2M1SHOT
+    return sc->Run() ? 0 : -1;
+#else
+    return sc->Submit() ? 0 : -1;
+#endif
+}
+
+int exynos_sc_complete(void *handle)
+{
+    CScalerNonStream *sc = GetNonStreamScaler(handle);
+    if (!sc)
+        return -1;
+
+#ifdef SCALER_USE_M2M1SHOT
+    return 0;
+#else
+    return sc->Complete() ? 0 : -1;
+#endif
+}
+
 static CScalerBlendV4L2 *GetScalerBlend(void *handle)
 {
     if (handle == NULL) {
@@ -1,11 +1,16 @@
 #include "GpuSysfsReader.h"
 
+#include <android-base/properties.h>
+#include <dirent.h>
 #include <log/log.h>
+#include <stdlib.h>
 
+#include <cerrno>
+#include <chrono>
 #include <fstream>
-#include <sstream>
-
-#include "filesystem.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 #undef LOG_TAG
 #define LOG_TAG "memtrack-gpusysfsreader"
@@ -13,47 +18,106 @@
 using namespace GpuSysfsReader;
 
 namespace {
-uint64_t readNode(const std::string node, pid_t pid) {
-    std::stringstream ss;
-    if (pid)
-        ss << kSysfsDevicePath << "/" << kProcessDir << "/" << pid << "/" << node;
-    else
-        ss << kSysfsDevicePath << "/" << node;
-    const std::string path = ss.str();
-
-    if (!filesystem::exists(filesystem::path(path))) {
-        ALOGV("File not found: %s", path.c_str());
-        return 0;
-    }
+std::string getProcessPath(pid_t pid) {
+    return std::string(kSysfsDevicePath) + "/" + kProcessDir + "/" + std::to_string(pid);
+}
+
+uint64_t readNode(const std::string& dir, const char* node) {
+    const std::string path = dir + "/" + node;
 
     std::ifstream file(path.c_str());
     if (!file.is_open()) {
-        ALOGW("Failed to open %s path", path.c_str());
+        if (errno == ENOENT)
+            ALOGV("File not found: %s", path.c_str());
+        else
+            ALOGW("Failed to open %s path", path.c_str());
         return 0;
     }
 
-    uint64_t out;
+    uint64_t out = 0;
     file >> out;
-    file.close();
 
     return out;
 }
+
+uint64_t readNode(const char* node, pid_t pid) {
+    return readNode(pid ? getProcessPath(pid) : std::string(kSysfsDevicePath), node);
+}
+
+GpuMemUsage readGpuMemUsage(pid_t pid) {
+    return {
+            .dmaBufGpuMem = readNode(kDmaBufGpuMemNode, pid),
+            .gpuMemTotal = readNode(kTotalGpuMemNode, pid),
+    };
+}
+
+// Only processes holding GPU memory have a directory in kProcessDir; the others read as 0
+// either way.
+void readAllGpuMemUsage(std::unordered_map<pid_t, GpuMemUsage>& usages) {
+    usages.clear();
+    usages[0] = readGpuMemUsage(0);
+
+    const std::string processPath = std::string(kSysfsDevicePath) + "/" + kProcessDir;
+    DIR* dir = opendir(processPath.c_str());
+    if (!dir) {
+        ALOGV("Failed to open %s directory", processPath.c_str());
+        return;
+    }
+
+    struct dirent* dent;
+    while ((dent = readdir(dir))) {
+        char* end;
+        long pid = strtol(dent->d_name, &end, 10);
+        if ((end == dent->d_name) || (*end != '\0') || (pid <= 0))
+            continue;
+        usages[pid] = readGpuMemUsage(pid);
+    }
+    closedir(dir);
+}
+
+struct Snapshot {
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point time;
+    bool valid = false;
+    std::unordered_map<pid_t, GpuMemUsage> usages;
+};
 } // namespace
 
+uint64_t GpuMemUsage::getPrivateGpuMem() const {
+    if (dmaBufGpuMem > gpuMemTotal) {
+        ALOGE("Bug in reader, dma-buf size (%" PRIu64 ") is higher than total gpu size (%" PRIu64
+              ")",
+              dmaBufGpuMem, gpuMemTotal);
+        return 0;
+    }
+
+    return gpuMemTotal - dmaBufGpuMem;
+}
+
 uint64_t GpuSysfsReader::getDmaBufGpuMem(pid_t pid) { return readNode(kDmaBufGpuMemNode, pid); }
 
 uint64_t GpuSysfsReader::getGpuMemTotal(pid_t pid) { return readNode(kTotalGpuMemNode, pid); }
 
 uint64_t GpuSysfsReader::getPrivateGpuMem(pid_t pid) {
-    auto dma_buf_size = getDmaBufGpuMem(pid);
-    auto gpu_total_size = getGpuMemTotal(pid);
+    return readGpuMemUsage(pid).getPrivateGpuMem();
+}
 
-    if (dma_buf_size > gpu_total_size) {
-        ALOGE("Bug in reader, dma-buf size (%" PRIu64 ") is higher than total gpu size (%" PRIu64
-              ")",
-              dma_buf_size, gpu_total_size);
-        return 0;
+GpuMemUsage GpuSysfsReader::getGpuMemUsage(pid_t pid) {
+    static const std::chrono::milliseconds maxAge(
+            android::base::GetIntProperty(kSnapshotMaxAgeProperty, kDefaultSnapshotMaxAgeMs));
+    static Snapshot snapshot;
+
+    if (maxAge.count() <= 0)
+        return readGpuMemUsage(pid);
+
+    std::lock_guard<std::mutex> lock(snapshot.mutex);
+    const auto now = std::chrono::steady_clock::now();
+    if (!snapshot.valid || (now - snapshot.time > maxAge)) {
+        readAllGpuMemUsage(snapshot.usages);
+        snapshot.time = now;
+        snapshot.valid = true;
     }
 
-    return gpu_total_size - dma_buf_size;
+    auto it = snapshot.usages.find(pid);
+    return (it == snapshot.usages.end()) ? GpuMemUsage{} : it->second;
 }
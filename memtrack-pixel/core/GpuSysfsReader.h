@@ -1,17 +1,32 @@
-
 #pragma once
 
 #include <inttypes.h>
 #include <sys/types.h>
 
 namespace GpuSysfsReader {
+struct GpuMemUsage {
+    uint64_t dmaBufGpuMem = 0;
+    uint64_t gpuMemTotal = 0;
+
+    uint64_t getPrivateGpuMem() const;
+};
+
 uint64_t getDmaBufGpuMem(pid_t pid = 0);
 uint64_t getGpuMemTotal(pid_t pid = 0);
 uint64_t getPrivateGpuMem(pid_t pid = 0);
 
+// Usage of |pid| (or of the whole device for pid 0) from a snapshot of all processes. The
+// snapshot is taken by a single walk of kProcessDir and reused for queries within
+// kSnapshotMaxAgeProperty milliseconds, so a client querying every process in turn only pays
+// for one scan. A max age of 0 reads the nodes of |pid| directly.
+GpuMemUsage getGpuMemUsage(pid_t pid = 0);
+
 constexpr char kSysfsDevicePath[] = "/sys/class/misc/mali0/device";
 constexpr char kProcessDir[] = "kprcs";
 constexpr char kMappedDmaBufsDir[] = "dma_bufs";
 constexpr char kTotalGpuMemNode[] = "total_gpu_mem";
 constexpr char kDmaBufGpuMemNode[] = "dma_buf_gpu_mem";
+
+constexpr char kSnapshotMaxAgeProperty[] = "vendor.memtrack.snapshot_max_age_ms";
+constexpr int kDefaultSnapshotMaxAgeMs = 1000;
 } // namespace GpuSysfsReader
@@ -35,16 +35,17 @@ ndk::ScopedAStatus Memtrack::getMemory(int pid, MemtrackType type,
     if (pid == 0 && type != MemtrackType::GL)
         return ndk::ScopedAStatus::ok();
 
+    const GpuSysfsReader::GpuMemUsage usage = GpuSysfsReader::getGpuMemUsage(pid);
     uint64_t size = 0;
     switch (type) {
         case MemtrackType::GL:
-            size = GpuSysfsReader::getPrivateGpuMem(pid);
+            size = usage.getPrivateGpuMem();
             break;
         case MemtrackType::GRAPHICS:
             // TODO(b/194483693): This is not PSS as required by memtrack HAL
             // but complete dmabuf allocations. Reporting PSS requires reading
             // procfs. This HAL does not have that permission yet.
-            size = GpuSysfsReader::getDmaBufGpuMem(pid);
+            size = usage.dmaBufGpuMem;
             break;
         default:
             break;